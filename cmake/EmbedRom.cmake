@@ -0,0 +1,53 @@
+# Concatenates the ROM segments into a C++ header with the image as a
+# constexpr byte array, so the emulator needs no ROM file at runtime.
+#
+# Run in script mode:
+#   cmake -DOUTPUT=<header> -DSEGMENTS=<seg1;seg2;...> -P EmbedRom.cmake
+
+if(NOT OUTPUT OR NOT SEGMENTS)
+    message(FATAL_ERROR "EmbedRom.cmake needs OUTPUT and SEGMENTS")
+endif()
+
+set(bytes "")
+set(names "")
+foreach(segment IN LISTS SEGMENTS)
+    file(READ "${segment}" hex HEX)
+    string(APPEND bytes "${hex}")
+    get_filename_component(name "${segment}" NAME)
+    list(APPEND names "${name}")
+endforeach()
+
+string(LENGTH "${bytes}" hexLength)
+math(EXPR size "${hexLength} / 2")
+
+# 16 bytes per line
+set(lines "")
+set(offset 0)
+while(offset LESS hexLength)
+    string(SUBSTRING "${bytes}" ${offset} 32 line)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " line "${line}")
+    string(STRIP "${line}" line)
+    string(APPEND lines "    ${line}\n")
+    math(EXPR offset "${offset} + 32")
+endwhile()
+list(JOIN names ", " names)
+
+file(WRITE "${OUTPUT}.tmp"
+"// Generated by cmake/EmbedRom.cmake from ${names}; do not edit.
+#ifndef INVADERS_ROM_H
+#define INVADERS_ROM_H
+
+#include <cstddef>
+#include <cstdint>
+
+inline constexpr uint8_t INVADERS_ROM[] = {
+${lines}};
+inline constexpr size_t INVADERS_ROM_SIZE = ${size};
+static_assert(sizeof(INVADERS_ROM) == INVADERS_ROM_SIZE, \"ROM image size mismatch\");
+
+#endif // INVADERS_ROM_H
+")
+
+# Only touch the header when the image changed, so nothing rebuilds needlessly
+configure_file("${OUTPUT}.tmp" "${OUTPUT}" COPYONLY)
+file(REMOVE "${OUTPUT}.tmp")
@@ -0,0 +1,447 @@
+#include "asynclog.h"
+#include "../outputmanager/spscring.h"
+#include <QDebug>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+
+constexpr int MAX_ARGS = 8;                ///< Conversions (and '*' widths) captured per record
+constexpr size_t STRING_BYTES = 48;        ///< Room for copied %s arguments, terminators included
+constexpr size_t RING_RECORDS = 256;       ///< Per thread
+constexpr size_t MAX_THREADS = 32;         ///< Threads logging at once; more lose their records (counted)
+constexpr int FORMATTER_INTERVAL_MS = 5;
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct LogRecord {
+    int64_t timestampNs;
+    const char* format;
+    uint8_t level;
+    uint8_t argCount;
+    uint8_t stringBytes;
+    uint64_t args[MAX_ARGS];
+    char strings[STRING_BYTES];
+};
+
+// One printf conversion specification, as found in a format string
+struct Conversion {
+    enum Kind { Literal, Percent, Signed, Unsigned, Double, String, Pointer, Char, Unsupported };
+    Kind kind;
+    const char* start;   ///< The '%'
+    const char* end;     ///< One past the conversion character
+    char length[3];      ///< Length modifier, e.g. "ll"
+    int stars;           ///< '*' widths/precisions, each taking an int argument first
+};
+
+// Finds the next conversion at or after p; Literal with end == p means the end of the format
+Conversion nextConversion(const char* p) {
+    Conversion conversion = { Conversion::Literal, p, p, { 0, 0, 0 }, 0 };
+    const char* percent = std::strchr(p, '%');
+    if (!percent) {
+        conversion.end = p + std::strlen(p);
+        return conversion;
+    }
+    if (percent != p) {
+        conversion.end = percent; // Text before the next conversion
+        return conversion;
+    }
+
+    const char* q = p + 1;
+    while (*q && std::strchr("-+ #0", *q)) {
+        ++q;
+    }
+    for (int part = 0; part < 2; ++part) { // Width, then precision
+        if (part == 1) {
+            if (*q != '.') {
+                break;
+            }
+            ++q;
+        }
+        if (*q == '*') {
+            ++conversion.stars;
+            ++q;
+        }
+        while (*q >= '0' && *q <= '9') {
+            ++q;
+        }
+    }
+    int lengthChars = 0;
+    while (*q && std::strchr("hljztL", *q) && lengthChars < 2) {
+        conversion.length[lengthChars++] = *q++;
+    }
+
+    switch (*q) {
+    case '%': conversion.kind = Conversion::Percent; break;
+    case 'd': case 'i': conversion.kind = Conversion::Signed; break;
+    case 'o': case 'u': case 'x': case 'X': conversion.kind = Conversion::Unsigned; break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        conversion.kind = Conversion::Double;
+        break;
+    case 's': conversion.kind = Conversion::String; break;
+    case 'p': conversion.kind = Conversion::Pointer; break;
+    case 'c': conversion.kind = Conversion::Char; break;
+    default: conversion.kind = Conversion::Unsupported; break;
+    }
+    conversion.end = *q ? q + 1 : q;
+    return conversion;
+}
+
+int64_t readSigned(va_list& args, const char* length) {
+    if (!std::strcmp(length, "hh") || !std::strcmp(length, "h") || !*length) {
+        return va_arg(args, int);
+    }
+    if (!std::strcmp(length, "l")) {
+        return va_arg(args, long);
+    }
+    if (!std::strcmp(length, "j")) {
+        return va_arg(args, intmax_t);
+    }
+    if (!std::strcmp(length, "z") || !std::strcmp(length, "t")) {
+        return va_arg(args, ptrdiff_t);
+    }
+    return va_arg(args, long long);
+}
+
+uint64_t readUnsigned(va_list& args, const char* length) {
+    if (!std::strcmp(length, "hh") || !std::strcmp(length, "h") || !*length) {
+        return va_arg(args, unsigned int);
+    }
+    if (!std::strcmp(length, "l")) {
+        return va_arg(args, unsigned long);
+    }
+    if (!std::strcmp(length, "j")) {
+        return va_arg(args, uintmax_t);
+    }
+    if (!std::strcmp(length, "z") || !std::strcmp(length, "t")) {
+        return va_arg(args, size_t);
+    }
+    return va_arg(args, unsigned long long);
+}
+
+// Copies the argument values out of the va_list without formatting them
+void captureArgs(LogRecord& record, va_list& args) {
+    for (const char* p = record.format; *p;) {
+        const Conversion conversion = nextConversion(p);
+        p = conversion.end;
+        if (conversion.kind == Conversion::Literal || conversion.kind == Conversion::Percent) {
+            continue;
+        }
+        if (conversion.kind == Conversion::Unsupported || record.argCount + conversion.stars + 1 > MAX_ARGS) {
+            return; // The rest of the message is printed without values
+        }
+        for (int s = 0; s < conversion.stars; ++s) {
+            record.args[record.argCount++] = static_cast<uint64_t>(static_cast<int64_t>(va_arg(args, int)));
+        }
+
+        uint64_t& slot = record.args[record.argCount++];
+        switch (conversion.kind) {
+        case Conversion::Signed:
+            slot = static_cast<uint64_t>(readSigned(args, conversion.length));
+            break;
+        case Conversion::Unsigned:
+            slot = readUnsigned(args, conversion.length);
+            break;
+        case Conversion::Double: {
+            const double value = conversion.length[0] == 'L' ? static_cast<double>(va_arg(args, long double))
+                                                             : va_arg(args, double);
+            std::memcpy(&slot, &value, sizeof(value));
+            break;
+        }
+        case Conversion::Char:
+            slot = static_cast<uint64_t>(va_arg(args, int));
+            break;
+        case Conversion::Pointer:
+            slot = reinterpret_cast<uintptr_t>(va_arg(args, void*));
+            break;
+        case Conversion::String: {
+            // The caller's string may be gone by the time the record is formatted
+            const char* text = va_arg(args, const char*);
+            if (!text) {
+                text = "(null)";
+            }
+            const size_t room = STRING_BYTES - record.stringBytes;
+            const size_t length = room ? std::min(std::strlen(text), room - 1) : 0;
+            slot = record.stringBytes;
+            if (room) {
+                std::memcpy(record.strings + record.stringBytes, text, length);
+                record.strings[record.stringBytes + length] = '\0';
+                record.stringBytes = static_cast<uint8_t>(record.stringBytes + length + 1);
+            } else {
+                slot = STRING_BYTES; // Out of room: printed as empty
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+// Formats a record the way printf would have, on the formatter thread
+std::string formatRecord(const LogRecord& record) {
+    std::string out;
+    char piece[512];
+    int arg = 0;
+    for (const char* p = record.format; *p;) {
+        const Conversion conversion = nextConversion(p);
+        p = conversion.end;
+        if (conversion.kind == Conversion::Literal) {
+            out.append(conversion.start, conversion.end);
+            continue;
+        }
+        if (conversion.kind == Conversion::Percent) {
+            out += '%';
+            continue;
+        }
+        if (conversion.kind == Conversion::Unsupported || arg + conversion.stars + 1 > record.argCount) {
+            out.append(conversion.start); // Values were not captured
+            break;
+        }
+
+        // Rebuild the spec with '*' filled in and the length normalised to what was stored
+        std::string spec;
+        const char* specEnd = conversion.end - 1;
+        for (const char* c = conversion.start; c < specEnd; ++c) {
+            if (*c == '*') {
+                spec += std::to_string(static_cast<int64_t>(record.args[arg++]));
+            } else if (!std::strchr("hljztL", *c)) {
+                spec += *c;
+            }
+        }
+        const uint64_t value = record.args[arg++];
+        switch (conversion.kind) {
+        case Conversion::Signed:
+            spec += "ll";
+            spec += *specEnd;
+            std::snprintf(piece, sizeof(piece), spec.c_str(), static_cast<long long>(value));
+            break;
+        case Conversion::Unsigned:
+            spec += "ll";
+            spec += *specEnd;
+            std::snprintf(piece, sizeof(piece), spec.c_str(), static_cast<unsigned long long>(value));
+            break;
+        case Conversion::Double: {
+            double number;
+            std::memcpy(&number, &value, sizeof(number));
+            spec += *specEnd;
+            std::snprintf(piece, sizeof(piece), spec.c_str(), number);
+            break;
+        }
+        case Conversion::Char:
+            spec += 'c';
+            std::snprintf(piece, sizeof(piece), spec.c_str(), static_cast<int>(value));
+            break;
+        case Conversion::Pointer:
+            spec += 'p';
+            std::snprintf(piece, sizeof(piece), spec.c_str(), reinterpret_cast<void*>(static_cast<uintptr_t>(value)));
+            break;
+        case Conversion::String:
+            spec += 's';
+            std::snprintf(piece, sizeof(piece), spec.c_str(), value < STRING_BYTES ? record.strings + value : "");
+            break;
+        default:
+            piece[0] = '\0';
+            break;
+        }
+        out += piece;
+    }
+
+    // Callers written for printf end lines themselves; Qt adds its own
+    while (!out.empty() && out.back() == '\n') {
+        out.pop_back();
+    }
+    return out;
+}
+
+struct ThreadRing {
+    SpscRing<LogRecord, RING_RECORDS> records;
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<bool> owned{ true };      ///< A live thread writes to it
+    std::atomic<bool> available{ false }; ///< Its thread exited and every record was written
+    int index = 0;
+};
+
+// Gives the ring back when its thread exits; the formatter frees it once drained
+struct RingOwner {
+    ThreadRing* ring = nullptr;
+    bool registered = false;
+    ~RingOwner() {
+        if (ring) {
+            ring->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+class Logger {
+public:
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    // Wait-free after the calling thread's first record
+    void record(int level, const char* format, va_list& args) {
+        ThreadRing* ring = ringForThisThread();
+        if (!ring) {
+            refused.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        LogRecord entry;
+        entry.timestampNs = nowNs();
+        entry.format = format;
+        entry.level = static_cast<uint8_t>(level);
+        entry.argCount = 0;
+        entry.stringBytes = 0;
+        captureArgs(entry, args);
+        if (!ring->records.push(entry)) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void flush() {
+        if (!running.load(std::memory_order_acquire)) {
+            return;
+        }
+        const uint64_t ticket = flushRequested.fetch_add(1, std::memory_order_acq_rel) + 1;
+        while (flushCompleted.load(std::memory_order_acquire) < ticket && running.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    Logger() : ringCount(0), refused(0), running(true), flushRequested(0), flushCompleted(0), startNs(nowNs()) {
+        formatter = std::thread(&Logger::run, this);
+    }
+
+    ~Logger() {
+        running.store(false, std::memory_order_release);
+        formatter.join();
+        drainAll();
+    }
+
+    ThreadRing* ringForThisThread() {
+        thread_local RingOwner owner;
+        if (!owner.registered) {
+            owner.registered = true;
+            owner.ring = claimRing(); // Once per thread
+        }
+        return owner.ring;
+    }
+
+    // Reuses the ring of an exited thread, or adds one while there is room
+    ThreadRing* claimRing() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        const size_t count = ringCount.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            ThreadRing* ring = rings[i];
+            if (ring->available.load(std::memory_order_acquire)) {
+                // Owned first: the formatter only looks at owned while available is false
+                ring->owned.store(true, std::memory_order_relaxed);
+                ring->available.store(false, std::memory_order_release);
+                return ring;
+            }
+        }
+        if (count == MAX_THREADS) {
+            return nullptr;
+        }
+        // Kept for the life of the process and reused, since a thread may exit with records still queued
+        ThreadRing* ring = new ThreadRing;
+        ring->index = static_cast<int>(count);
+        rings[count] = ring;
+        ringCount.store(count + 1, std::memory_order_release);
+        return ring;
+    }
+
+    void run() {
+        while (running.load(std::memory_order_acquire)) {
+            const uint64_t requested = flushRequested.load(std::memory_order_acquire);
+            drainAll();
+            flushCompleted.store(requested, std::memory_order_release);
+            std::this_thread::sleep_for(std::chrono::milliseconds(FORMATTER_INTERVAL_MS));
+        }
+    }
+
+    void drainAll() {
+        const size_t count = ringCount.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            ThreadRing* ring = rings[i];
+            if (ring->available.load(std::memory_order_acquire)) {
+                continue;
+            }
+            // Read before draining: once the owner has gone, this drain empties the ring for good
+            const bool exited = !ring->owned.load(std::memory_order_acquire);
+            LogRecord entry;
+            while (ring->records.pop(entry)) {
+                write(ring->index, entry);
+            }
+            if (const uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+                qWarning("[T%d] %llu log records dropped, ring full", ring->index,
+                         static_cast<unsigned long long>(dropped));
+            }
+            if (exited) {
+                ring->available.store(true, std::memory_order_release);
+            }
+        }
+        if (const uint64_t lost = refused.exchange(0, std::memory_order_relaxed)) {
+            qWarning("%llu log records lost, more than %zu threads logging at once",
+                     static_cast<unsigned long long>(lost), MAX_THREADS);
+        }
+    }
+
+    void write(int thread, const LogRecord& entry) {
+        const std::string text = formatRecord(entry);
+        const double ms = (entry.timestampNs - startNs) / 1e6;
+        switch (entry.level) {
+        case ASYNCLOG_LEVEL_TRACE:
+        case ASYNCLOG_LEVEL_DEBUG:
+            qDebug("[T%d %10.3f ms] %s", thread, ms, text.c_str());
+            break;
+        case ASYNCLOG_LEVEL_INFO:
+            qInfo("[T%d %10.3f ms] %s", thread, ms, text.c_str());
+            break;
+        case ASYNCLOG_LEVEL_WARN:
+            qWarning("[T%d %10.3f ms] %s", thread, ms, text.c_str());
+            break;
+        default:
+            qCritical("[T%d %10.3f ms] %s", thread, ms, text.c_str());
+            break;
+        }
+    }
+
+    std::mutex registryMutex;
+    std::array<ThreadRing*, MAX_THREADS> rings{};
+    std::atomic<size_t> ringCount;
+    std::atomic<uint64_t> refused; ///< Records from threads that found no free ring
+    std::atomic<bool> running;
+    std::atomic<uint64_t> flushRequested;
+    std::atomic<uint64_t> flushCompleted;
+    int64_t startNs;
+    std::thread formatter;
+};
+
+} // namespace
+
+extern "C" void asynclog_record(int level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    Logger::instance().record(level, format, args);
+    va_end(args);
+}
+
+extern "C" void asynclog_flush(void) {
+    Logger::instance().flush();
+}
@@ -0,0 +1,80 @@
+#ifndef ASYNCLOG_H
+#define ASYNCLOG_H
+
+/**
+ * @brief Asynchronous logger for the emulator core and other hot paths.
+ *
+ * A call copies the format pointer and the raw argument values into a
+ * fixed-size record on the calling thread's own lock-free ring; nothing is
+ * formatted, allocated or locked there, and a full ring drops the record
+ * (counted) instead of waiting. A background thread formats the records and
+ * hands them to Qt's message handler. When a thread exits, its ring is
+ * reused by the next new thread once its last records are written, so
+ * threads started per game do not use up the 32 rings.
+ *
+ * Levels below ASYNCLOG_MIN_LEVEL compile to nothing, arguments included.
+ * Formats must be string literals; %s arguments are copied (up to 47
+ * bytes per record), other conversions are stored as 64-bit values, at
+ * most 8 per record. %n is not supported.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ASYNCLOG_LEVEL_TRACE 0
+#define ASYNCLOG_LEVEL_DEBUG 1
+#define ASYNCLOG_LEVEL_INFO  2
+#define ASYNCLOG_LEVEL_WARN  3
+#define ASYNCLOG_LEVEL_ERROR 4
+#define ASYNCLOG_LEVEL_OFF   5
+
+#ifndef ASYNCLOG_MIN_LEVEL
+#ifdef NDEBUG
+#define ASYNCLOG_MIN_LEVEL ASYNCLOG_LEVEL_INFO
+#else
+#define ASYNCLOG_MIN_LEVEL ASYNCLOG_LEVEL_DEBUG
+#endif
+#endif
+
+// Queues a record; use the ALOG_* macros instead so disabled levels vanish
+void asynclog_record(int level, const char* format, ...);
+
+// Blocks until everything queued so far has been written. Not for hot paths.
+void asynclog_flush(void);
+
+#if ASYNCLOG_MIN_LEVEL <= ASYNCLOG_LEVEL_TRACE
+#define ALOG_TRACE(...) asynclog_record(ASYNCLOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define ALOG_TRACE(...) ((void)0)
+#endif
+
+#if ASYNCLOG_MIN_LEVEL <= ASYNCLOG_LEVEL_DEBUG
+#define ALOG_DEBUG(...) asynclog_record(ASYNCLOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define ALOG_DEBUG(...) ((void)0)
+#endif
+
+#if ASYNCLOG_MIN_LEVEL <= ASYNCLOG_LEVEL_INFO
+#define ALOG_INFO(...) asynclog_record(ASYNCLOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define ALOG_INFO(...) ((void)0)
+#endif
+
+#if ASYNCLOG_MIN_LEVEL <= ASYNCLOG_LEVEL_WARN
+#define ALOG_WARN(...) asynclog_record(ASYNCLOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define ALOG_WARN(...) ((void)0)
+#endif
+
+#if ASYNCLOG_MIN_LEVEL <= ASYNCLOG_LEVEL_ERROR
+#define ALOG_ERROR(...) asynclog_record(ASYNCLOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define ALOG_ERROR(...) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ASYNCLOG_H
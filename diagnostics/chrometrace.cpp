@@ -0,0 +1,149 @@
+#include "chrometrace.h"
+#include <QDebug>
+#include <QFile>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ChromeTrace {
+
+std::atomic<bool> active(false);
+
+namespace {
+
+constexpr size_t EVENTS_PER_THREAD = 1 << 17; ///< 3 MB per thread, several minutes of play
+
+struct Event {
+    int64_t timestamp; ///< ns
+    int64_t duration;  ///< ns, or -1 for an instant
+    const char* name;
+};
+
+struct ThreadBuffer {
+    std::unique_ptr<Event[]> events; ///< Allocated by the first event, so naming a thread costs nothing
+    std::atomic<size_t> count{ 0 }; ///< Events below this are complete and never change
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<const char*> name{ nullptr };
+    int id = 0;
+};
+
+std::mutex registryMutex;
+std::vector<ThreadBuffer*> registry; // Never freed; a thread may end before the trace is written
+
+const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+ThreadBuffer& threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        buffer = new ThreadBuffer;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->id = int(registry.size()) + 1;
+        registry.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void append(const char* name, int64_t timestamp, int64_t duration) {
+    ThreadBuffer& buffer = threadBuffer();
+    const size_t index = buffer.count.load(std::memory_order_relaxed);
+    if (index >= EVENTS_PER_THREAD) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!buffer.events) {
+        buffer.events.reset(new Event[EVENTS_PER_THREAD]); // Published by the count store below
+    }
+    buffer.events[index] = { timestamp, duration, name };
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+} // namespace
+
+void setEnabled(bool enable) {
+    active.store(enable, std::memory_order_relaxed);
+    qDebug() << "Chrome trace" << (enable ? "recording" : "stopped");
+}
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void setThreadName(const char* name) {
+    threadBuffer().name.store(name, std::memory_order_release);
+}
+
+void complete(const char* name, int64_t startNs) {
+    if (enabled()) {
+        append(name, startNs, now() - startNs);
+    }
+}
+
+void instant(const char* name) {
+    if (enabled()) {
+        append(name, now(), -1);
+    }
+}
+
+bool write(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not write Chrome trace" << path << file.errorString();
+        return false;
+    }
+
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separate = [&]() {
+        if (!first) {
+            json += ",\n";
+        }
+        first = false;
+    };
+
+    size_t total = 0;
+    uint64_t dropped = 0;
+    for (const ThreadBuffer* buffer : buffers) {
+        const char* name = buffer->name.load(std::memory_order_acquire);
+        separate();
+        json += QStringLiteral("{\"ph\":\"M\",\"pid\":1,\"tid\":%1,\"name\":\"thread_name\",\"args\":{\"name\":\"%2\"}}")
+                    .arg(buffer->id)
+                    .arg(name ? QString::fromLatin1(name) : QStringLiteral("thread %1").arg(buffer->id))
+                    .toUtf8();
+
+        const size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const Event& event = buffer->events[i];
+            separate();
+            if (event.duration >= 0) {
+                json += QByteArray("{\"ph\":\"X\",\"pid\":1,\"tid\":") + QByteArray::number(buffer->id)
+                        + ",\"ts\":" + QByteArray::number(event.timestamp / 1000.0, 'f', 3)
+                        + ",\"dur\":" + QByteArray::number(event.duration / 1000.0, 'f', 3)
+                        + ",\"name\":\"" + event.name + "\"}";
+            } else {
+                json += QByteArray("{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":") + QByteArray::number(buffer->id)
+                        + ",\"ts\":" + QByteArray::number(event.timestamp / 1000.0, 'f', 3)
+                        + ",\"name\":\"" + event.name + "\"}";
+            }
+        }
+        total += count;
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    json += "\n]}\n";
+
+    if (file.write(json) != json.size()) {
+        qWarning() << "Could not write Chrome trace" << path << file.errorString();
+        return false;
+    }
+    qDebug() << "Chrome trace written to" << path << ":" << total << "events on" << buffers.size() << "threads,"
+             << dropped << "dropped";
+    return true;
+}
+
+} // namespace ChromeTrace
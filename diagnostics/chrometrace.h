@@ -0,0 +1,84 @@
+#ifndef CHROMETRACE_H
+#define CHROMETRACE_H
+
+#include <QString>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Timeline of named events on every thread, saved as Chrome Trace Event JSON.
+ *
+ * Each thread appends to its own fixed-size buffer, so recording never locks
+ * or waits on another thread. A buffer that fills up keeps its first events
+ * and counts the rest as dropped. Open the written file in chrome://tracing
+ * or ui.perfetto.dev to see frame pacing, queue delays between threads, and
+ * the time from a key press to the frame that shows it.
+ *
+ * Event names must be string literals; only the pointer is stored.
+ */
+namespace ChromeTrace {
+
+extern std::atomic<bool> active;
+
+/**
+ * @brief Starts or stops recording on all threads.
+ */
+void setEnabled(bool enable);
+
+inline bool enabled() {
+    return active.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Monotonic timestamp in nanoseconds, on the clock the events use.
+ */
+int64_t now();
+
+/**
+ * @brief Labels the calling thread in the trace viewer.
+ */
+void setThreadName(const char* name);
+
+/**
+ * @brief Records a span on the calling thread from startNs (see now()) until now.
+ */
+void complete(const char* name, int64_t startNs);
+
+/**
+ * @brief Records a point in time on the calling thread.
+ */
+void instant(const char* name);
+
+/**
+ * @brief Writes everything recorded so far. Safe while other threads keep recording.
+ * @return False if the file could not be written.
+ */
+bool write(const QString& path);
+
+/**
+ * @brief Records the enclosing block as a span, if tracing is on when it starts.
+ */
+class Scope {
+public:
+    explicit Scope(const char* spanName) : name(spanName), start(enabled() ? now() : -1) {}
+    ~Scope() {
+        if (start >= 0) {
+            complete(name, start);
+        }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+} // namespace ChromeTrace
+
+#define CHROME_TRACE_CONCAT_(a, b) a##b
+#define CHROME_TRACE_CONCAT(a, b) CHROME_TRACE_CONCAT_(a, b)
+#define CHROME_TRACE_SCOPE(name) ChromeTrace::Scope CHROME_TRACE_CONCAT(chromeTraceScope, __LINE__)(name)
+
+#endif // CHROMETRACE_H
@@ -0,0 +1,101 @@
+#include "framebudget.h"
+#include "asynclog.h"
+#include <algorithm>
+
+const std::array<uint8_t, 256> FrameBudget::FLAGS = [] {
+    std::array<uint8_t, 256> flags = {};
+    flags[0xc3] = flags[0xcb] = JUMP; // JMP
+    for (int opcode = 0; opcode < 256; ++opcode) {
+        if ((opcode & 0xc7) == 0xc2) { // Jcc
+            flags[opcode] = JUMP;
+        }
+        if ((opcode & 0xc7) == 0xc4 || (opcode & 0xc7) == 0xc7 || (opcode & 0xcf) == 0xc5) { // Ccc, RST, PUSH
+            flags[opcode] = WRITES;
+        }
+        if (opcode >= 0x70 && opcode <= 0x77 && opcode != 0x76) { // MOV M,r
+            flags[opcode] = WRITES;
+        }
+    }
+    // STAX, SHLD, STA, INR M, DCR M, MVI M, CALL, XTHL, OUT
+    for (int opcode : { 0x02, 0x12, 0x22, 0x32, 0x34, 0x35, 0x36, 0xcd, 0xdd, 0xed, 0xfd, 0xe3, 0xd3 }) {
+        flags[opcode] = WRITES;
+    }
+    return flags;
+}();
+
+FrameBudget::FrameBudget()
+    : inIsr(false),
+    isrSp(0),
+    isrCycles(0),
+    mainCycles(0),
+    idleCycles(0),
+    loopPc(0),
+    iterationCycles(0),
+    iterationWrites(false),
+    window{},
+    windowFrames(0),
+    windowNext(0),
+    framesSinceLog(0),
+    publishedFrames(0),
+    publishedIsr(0),
+    publishedMain(0),
+    publishedIdle(0),
+    publishedPeakPermille(0)
+{
+}
+
+void FrameBudget::endFrame() {
+    // A wait loop cut off by the frame edge is counted as work
+    mainCycles += iterationCycles;
+    iterationCycles = 0;
+    iterationWrites = false;
+    loopPc = 0;
+
+    window[windowNext] = { isrCycles, mainCycles, idleCycles };
+    windowNext = (windowNext + 1) % WINDOW_FRAMES;
+    windowFrames = std::min(windowFrames + 1, WINDOW_FRAMES);
+    isrCycles = mainCycles = idleCycles = 0;
+
+    uint64_t isr = 0, main = 0, idle = 0;
+    uint32_t peak = 0;
+    for (int i = 0; i < windowFrames; ++i) {
+        const Frame& frame = window[i];
+        isr += frame.isr;
+        main += frame.main;
+        idle += frame.idle;
+        const uint32_t total = frame.isr + frame.main + frame.idle;
+        if (total) {
+            peak = std::max(peak, uint32_t(1000ull * (frame.isr + frame.main) / total));
+        }
+    }
+    publishedIsr.store(isr, std::memory_order_relaxed);
+    publishedMain.store(main, std::memory_order_relaxed);
+    publishedIdle.store(idle, std::memory_order_relaxed);
+    publishedPeakPermille.store(peak, std::memory_order_relaxed);
+    publishedFrames.store(windowFrames, std::memory_order_relaxed);
+
+    if (++framesSinceLog >= LOG_FRAMES) {
+        framesSinceLog = 0;
+        const Summary s = summary();
+        ALOG_INFO("Frame budget over %d frames: ISR %.1f%%, main %.1f%%, idle %.1f%%, busiest frame %.1f%%",
+                  s.frames, s.isrPercent, s.mainPercent, s.idlePercent, s.peakBusyPercent);
+    }
+}
+
+FrameBudget::Summary FrameBudget::summary() const {
+    // The fields are published separately, so a reader may mix two adjacent
+    // windows; that is well inside what a rolling average can show
+    Summary s = {};
+    s.frames = publishedFrames.load(std::memory_order_relaxed);
+    const uint64_t isr = publishedIsr.load(std::memory_order_relaxed);
+    const uint64_t main = publishedMain.load(std::memory_order_relaxed);
+    const uint64_t idle = publishedIdle.load(std::memory_order_relaxed);
+    const uint64_t total = isr + main + idle;
+    if (total) {
+        s.isrPercent = 100.0 * isr / total;
+        s.mainPercent = 100.0 * main / total;
+        s.idlePercent = 100.0 * idle / total;
+    }
+    s.peakBusyPercent = publishedPeakPermille.load(std::memory_order_relaxed) / 10.0;
+    return s;
+}
@@ -0,0 +1,116 @@
+#ifndef FRAMEBUDGET_H
+#define FRAMEBUDGET_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Splits each emulated frame's cycles into interrupt handler, main-loop work and idle spinning.
+ *
+ * Cycles run while a scanline interrupt is being serviced count as ISR time.
+ * The handler lasts until the stack is popped above the interrupt's return
+ * address. In the main program, a short backward jump loop that writes
+ * nothing is a wait loop once it has gone round twice. Its further
+ * iterations count as idle; everything else counts as work.
+ *
+ * Totals over the last WINDOW_FRAMES frames are published after every frame
+ * and can be read from any thread with summary(). Every LOG_FRAMES frames
+ * one line is written to the log.
+ */
+class FrameBudget {
+public:
+    static constexpr int WINDOW_FRAMES = 60;          ///< Frames behind summary()
+    static constexpr int LOG_FRAMES = 600;            ///< Frames between log lines
+    static constexpr int IDLE_LOOP_BYTES = 8;         ///< Longest loop body taken for a wait loop
+    static constexpr int IDLE_ITERATION_CYCLES = 64;  ///< Longest wait loop iteration
+
+    struct Summary {
+        int frames;            ///< Frames in the window, up to WINDOW_FRAMES
+        double isrPercent;     ///< Shares of all cycles in the window
+        double mainPercent;
+        double idlePercent;
+        double peakBusyPercent; ///< ISR plus main of the busiest frame, as a share of its cycles
+    };
+
+    FrameBudget();
+
+    /**
+     * @brief Classifies one executed instruction. Emulation thread only.
+     * @param nextPc PC after it executed.
+     * @param sp SP after it executed.
+     */
+    void count(uint16_t pc, uint8_t opcode, uint16_t nextPc, uint16_t sp, int cycles) {
+        if (inIsr) {
+            isrCycles += cycles;
+            inIsr = sp <= isrSp; // Still below the interrupt's return address
+            return;
+        }
+
+        iterationCycles += cycles;
+        iterationWrites |= (FLAGS[opcode] & WRITES) != 0;
+        if ((FLAGS[opcode] & JUMP) && nextPc < pc && pc - nextPc <= IDLE_LOOP_BYTES) {
+            const bool idle = loopPc == pc && !iterationWrites && iterationCycles <= IDLE_ITERATION_CYCLES;
+            (idle ? idleCycles : mainCycles) += iterationCycles;
+            loopPc = pc;
+            iterationCycles = 0;
+            iterationWrites = false;
+        }
+    }
+
+    /**
+     * @brief An interrupt was delivered. Call after its return address was pushed.
+     */
+    void interrupt(uint16_t sp) {
+        if (!inIsr) { // A nested interrupt ends with the outer one
+            inIsr = true;
+            isrSp = sp;
+        }
+    }
+
+    /**
+     * @brief Closes the current frame and publishes the window. Emulation thread only.
+     */
+    void endFrame();
+
+    /**
+     * @brief Totals over the last WINDOW_FRAMES frames. Safe from any thread.
+     */
+    Summary summary() const;
+
+private:
+    enum : uint8_t { JUMP = 1, WRITES = 2 };
+    static const std::array<uint8_t, 256> FLAGS;
+
+    struct Frame {
+        uint32_t isr;
+        uint32_t main;
+        uint32_t idle;
+    };
+
+    // Current frame
+    bool inIsr;
+    uint16_t isrSp;
+    uint32_t isrCycles;
+    uint32_t mainCycles;
+    uint32_t idleCycles;
+
+    // Main-program cycles since the last short backward jump
+    uint16_t loopPc;
+    uint32_t iterationCycles;
+    bool iterationWrites;
+
+    std::array<Frame, WINDOW_FRAMES> window;
+    int windowFrames;
+    int windowNext;
+    int framesSinceLog;
+
+    // Published window; written once per frame, read by summary()
+    std::atomic<int> publishedFrames;
+    std::atomic<uint64_t> publishedIsr;
+    std::atomic<uint64_t> publishedMain;
+    std::atomic<uint64_t> publishedIdle;
+    std::atomic<uint32_t> publishedPeakPermille;
+};
+
+#endif // FRAMEBUDGET_H
@@ -0,0 +1,206 @@
+#include "hostcounters.h"
+#include "asynclog.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* const EVENT_NAMES[] = { "cycles", "instructions", "branch-misses", "L1D read misses" };
+
+} // namespace
+
+HostCounters::HostCounters()
+    : wanted(false),
+    failed(false),
+    spinning(false),
+    spinNoted(false),
+    primed(false),
+    lastEmulated(0),
+    emulatedSum(0),
+    frames(0)
+{
+    for (int i = 0; i < EVENT_COUNT; ++i) {
+        fds[i] = -1;
+        groupIndex[i] = -1;
+        last[i] = 0;
+        sums[i] = 0;
+    }
+}
+
+HostCounters::~HostCounters() {
+    close();
+}
+
+void HostCounters::setPacingSpin(bool spin) {
+    if (spin == spinning) {
+        return;
+    }
+    spinning = spin;
+
+    // Start a fresh window so spin-paced and unpaced frames are never mixed
+    primed = false;
+    for (int i = 0; i < EVENT_COUNT; ++i) {
+        sums[i] = 0;
+    }
+    emulatedSum = 0;
+    frames = 0;
+}
+
+void HostCounters::endFrame(uint64_t emulatedInstructions) {
+    if (!wanted || failed) {
+        return;
+    }
+    if (spinning) {
+        if (!spinNoted) {
+            ALOG_INFO("Host counters skip wall-clock paced frames; use audio pacing or --render-audio to measure");
+            spinNoted = true;
+        }
+        return;
+    }
+    if (owner != std::this_thread::get_id()) {
+        close();
+        if (!open()) {
+            failed = true;
+            return;
+        }
+        owner = std::this_thread::get_id();
+    }
+
+    uint64_t values[EVENT_COUNT];
+    if (!read(values)) {
+        return;
+    }
+    if (primed) {
+        for (int i = 0; i < EVENT_COUNT; ++i) {
+            sums[i] += values[i] - last[i];
+        }
+        emulatedSum += emulatedInstructions - lastEmulated;
+        if (++frames >= LOG_FRAMES) {
+            report();
+        }
+    }
+    std::memcpy(last, values, sizeof(last));
+    lastEmulated = emulatedInstructions;
+    primed = true;
+}
+
+#ifdef __linux__
+
+bool HostCounters::open() {
+    struct Config {
+        uint32_t type;
+        uint64_t config;
+    };
+    const Config configs[EVENT_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    };
+
+    // One group, led by cycles, so all counters cover the same instructions
+    int members = 0;
+    for (int i = 0; i < EVENT_COUNT; ++i) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = configs[i].type;
+        attr.config = configs[i].config;
+        attr.disabled = i == CYCLES;
+        attr.exclude_kernel = 1; // Allowed at the default perf_event_paranoid level
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, i == CYCLES ? -1 : fds[CYCLES], 0));
+        if (fd < 0) {
+            if (i == CYCLES) {
+                ALOG_WARN("Host performance counters unavailable (%s); frame counters disabled", std::strerror(errno));
+                return false;
+            }
+            ALOG_INFO("Host counter %s unavailable (%s); reporting without it", EVENT_NAMES[i], std::strerror(errno));
+            continue;
+        }
+        fds[i] = fd;
+        groupIndex[i] = members++;
+    }
+
+    ioctl(fds[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    primed = false;
+    ALOG_INFO("Host performance counters enabled (%d events)", members);
+    return true;
+}
+
+void HostCounters::close() {
+    for (int i = 0; i < EVENT_COUNT; ++i) {
+        if (fds[i] >= 0) {
+            ::close(fds[i]);
+            fds[i] = -1;
+        }
+        groupIndex[i] = -1;
+    }
+    owner = std::thread::id();
+}
+
+bool HostCounters::read(uint64_t (&values)[EVENT_COUNT]) {
+    // nr, time enabled, time running, then one value per member
+    uint64_t buffer[3 + EVENT_COUNT];
+    if (::read(fds[CYCLES], buffer, sizeof(buffer)) < ssize_t(4 * sizeof(uint64_t))) {
+        return false;
+    }
+
+    // Scale up if the kernel had to multiplex the group with other users
+    const uint64_t enabled = buffer[1];
+    const uint64_t running = buffer[2];
+    const double scale = running && running < enabled ? double(enabled) / running : 1.0;
+    for (int i = 0; i < EVENT_COUNT; ++i) {
+        values[i] = groupIndex[i] >= 0 ? uint64_t(buffer[3 + groupIndex[i]] * scale) : 0;
+    }
+    return true;
+}
+
+#else
+
+bool HostCounters::open() {
+    ALOG_WARN("Host performance counters are only supported on Linux; frame counters disabled");
+    return false;
+}
+
+void HostCounters::close() {
+}
+
+bool HostCounters::read(uint64_t (&)[EVENT_COUNT]) {
+    return false;
+}
+
+#endif
+
+void HostCounters::report() {
+    ALOG_INFO("Host cycles per frame over %d frames: %.0f", frames, double(sums[CYCLES]) / frames);
+    if (groupIndex[INSTRUCTIONS] >= 0 && sums[CYCLES] && emulatedSum) {
+        ALOG_INFO("Host instructions per frame: %.0f, IPC %.2f, %.1f per 8080 instruction",
+                  double(sums[INSTRUCTIONS]) / frames, double(sums[INSTRUCTIONS]) / sums[CYCLES],
+                  double(sums[INSTRUCTIONS]) / emulatedSum);
+    }
+    if (groupIndex[BRANCH_MISSES] >= 0 && sums[INSTRUCTIONS]) {
+        ALOG_INFO("Host branch misses per frame: %.0f, %.2f per 1000 instructions",
+                  double(sums[BRANCH_MISSES]) / frames, 1000.0 * sums[BRANCH_MISSES] / sums[INSTRUCTIONS]);
+    }
+    if (groupIndex[L1D_MISSES] >= 0) {
+        ALOG_INFO("Host L1D read misses per frame: %.0f", double(sums[L1D_MISSES]) / frames);
+    }
+
+    for (int i = 0; i < EVENT_COUNT; ++i) {
+        sums[i] = 0;
+    }
+    emulatedSum = 0;
+    frames = 0;
+}
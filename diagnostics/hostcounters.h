@@ -0,0 +1,84 @@
+#ifndef HOSTCOUNTERS_H
+#define HOSTCOUNTERS_H
+
+#include <cstdint>
+#include <thread>
+
+/**
+ * @brief Host CPU hardware counters read around every emulated frame (Linux perf_event_open).
+ *
+ * Counts user-space cycles, instructions, branch misses and L1D read misses
+ * of the emulation thread. Every LOG_FRAMES frames it logs the averages per
+ * frame, IPC, and host instructions per emulated instruction. That shows
+ * why a dispatch path is slow, not just that it is.
+ *
+ * Only runs whose pacing does not spin are measured: audio-clock pacing,
+ * which sleeps, and unpaced runs such as --render-audio. Wall-clock pacing
+ * busy-waits on the clock before every instruction, and that spin would
+ * swamp the dispatch cost being measured. Reading the counters around each
+ * wait would take two system calls per instruction, so those frames are
+ * skipped instead and the log says so once.
+ *
+ * Optional and best effort: on other systems, or when the kernel refuses
+ * the counters (perf_event_paranoid, containers, VMs without a PMU), it
+ * logs the reason once and turns itself off. Counters the CPU lacks are
+ * left out of the report.
+ */
+class HostCounters {
+public:
+    static constexpr int LOG_FRAMES = 600;
+
+    HostCounters();
+    ~HostCounters();
+
+    HostCounters(const HostCounters&) = delete;
+    HostCounters& operator=(const HostCounters&) = delete;
+
+    /**
+     * @brief Turns counting on or off. Call before emulation starts.
+     */
+    void setEnabled(bool enable) { wanted = enable; }
+
+    /**
+     * @brief Tells the counters whether the emulation thread busy-waits between instructions.
+     *
+     * While it does, frames are not measured. Emulation thread only.
+     */
+    void setPacingSpin(bool spin);
+
+    /**
+     * @brief Reads the counters at a frame boundary.
+     *
+     * Opens them on first use. They count only the calling thread, so they
+     * are reopened if frames start arriving from another thread.
+     * @param emulatedInstructions Total 8080 instructions executed so far.
+     */
+    void endFrame(uint64_t emulatedInstructions);
+
+private:
+    enum Event { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, EVENT_COUNT };
+
+    bool open();
+    void close();
+    bool read(uint64_t (&values)[EVENT_COUNT]);
+    void report();
+
+    bool wanted;
+    bool failed;                 ///< Refused once; not retried
+    bool spinning;               ///< Frames include the wall-clock pacing spin
+    bool spinNoted;              ///< Skipping spin-paced frames has been logged
+    std::thread::id owner;       ///< Thread the counters are attached to
+    int fds[EVENT_COUNT];        ///< -1 where the event is not available
+    int groupIndex[EVENT_COUNT]; ///< Position in a group read, or -1
+
+    bool primed;                 ///< A previous reading exists
+    uint64_t last[EVENT_COUNT];
+    uint64_t lastEmulated;
+
+    // Totals since the last report
+    uint64_t sums[EVENT_COUNT];
+    uint64_t emulatedSum;
+    int frames;
+};
+
+#endif // HOSTCOUNTERS_H
@@ -0,0 +1,77 @@
+#include "instructiontrace.h"
+#include <QDebug>
+#include <QDir>
+#include <cstring>
+
+InstructionTrace::InstructionTrace()
+    : path(QDir::currentPath() + "/trace.bin"),
+    capacity(DEFAULT_RECORDS),
+    mapping(nullptr),
+    header(nullptr),
+    records(nullptr),
+    mask(0),
+    written(0),
+    active(false)
+{
+}
+
+InstructionTrace::~InstructionTrace() {
+    close();
+}
+
+void InstructionTrace::configure(const QString& tracePath, qint64 recordCount) {
+    path = tracePath;
+    recordCount = qBound(MIN_RECORDS, recordCount, MAX_RECORDS);
+    capacity = 1;
+    while (capacity < uint64_t(recordCount)) {
+        capacity <<= 1;
+    }
+}
+
+bool InstructionTrace::setEnabled(bool enable) {
+    if (enable && !mapping && !open()) {
+        return false;
+    }
+    active.store(enable, std::memory_order_release);
+    qDebug() << "Instruction trace" << (enable ? "started:" : "stopped:") << path;
+    return true;
+}
+
+bool InstructionTrace::open() {
+    const qint64 size = qint64(sizeof(trace_file_header) + capacity * sizeof(trace_record));
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !file.resize(size)) {
+        qWarning() << "Could not create instruction trace" << path << file.errorString();
+        file.close();
+        return false;
+    }
+    mapping = file.map(0, size);
+    if (!mapping) {
+        qWarning() << "Could not map instruction trace" << path << file.errorString();
+        file.close();
+        return false;
+    }
+
+    header = reinterpret_cast<trace_file_header*>(mapping);
+    records = reinterpret_cast<trace_record*>(mapping + sizeof(trace_file_header));
+    std::memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+    header->version = TRACE_VERSION;
+    header->record_size = sizeof(trace_record);
+    header->capacity = capacity;
+    header->written = 0;
+    mask = capacity - 1;
+    written = 0;
+    return true;
+}
+
+void InstructionTrace::close() {
+    active.store(false, std::memory_order_release);
+    if (mapping) {
+        file.unmap(mapping);
+        mapping = nullptr;
+        header = nullptr;
+        records = nullptr;
+        file.close();
+        qDebug() << "Instruction trace closed:" << written << "instructions recorded";
+    }
+}
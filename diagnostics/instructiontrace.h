@@ -0,0 +1,95 @@
+#ifndef INSTRUCTIONTRACE_H
+#define INSTRUCTIONTRACE_H
+
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include <cstdint>
+#include "tracerecord.h"
+#include "../disassembler/disassembler.h"
+
+/**
+ * @brief Records every executed instruction into a memory-mapped ring file.
+ *
+ * While enabled, record() copies PC, the instruction bytes, registers, flags
+ * and the cycle count into a fixed-size slot of the mapped file. It does not
+ * format, allocate or make a system call, so a trace costs a few nanoseconds
+ * per instruction. When the trace is off, the only cost is the enabled() check.
+ * The file keeps the most recent capacity instructions. Decode it with
+ * tools/tracedecode.
+ */
+class InstructionTrace {
+public:
+    static constexpr qint64 DEFAULT_RECORDS = 1 << 20; ///< 24 MB of trace, about four seconds of play
+    static constexpr qint64 MIN_RECORDS = 1 << 10;
+    static constexpr qint64 MAX_RECORDS = 1 << 26;
+
+    InstructionTrace();
+    ~InstructionTrace();
+
+    InstructionTrace(const InstructionTrace&) = delete;
+    InstructionTrace& operator=(const InstructionTrace&) = delete;
+
+    /**
+     * @brief Sets the file and ring size used the next time the trace is started.
+     * @param records Clamped to MIN_RECORDS..MAX_RECORDS and rounded up to a power of two.
+     */
+    void configure(const QString& path, qint64 records);
+
+    /**
+     * @brief Starts or stops recording. Safe from any thread.
+     *
+     * The first start creates and maps the file; starting again after a stop
+     * continues the same ring. The mapping is kept until close(). Starting
+     * publishes the mapping with a release store, which enabled() acquires
+     * before the emulation thread calls record().
+     * @return False if the file could not be created or mapped.
+     */
+    bool setEnabled(bool enable);
+
+    bool enabled() const { return active.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Stores the state about to execute. Emulation thread only, and only while enabled().
+     */
+    void record(const state_8080cpu& state, uint64_t cycle) {
+        trace_record& slot = records[written & mask];
+        slot.cycle = cycle;
+        slot.pc = state.pc;
+        slot.sp = state.sp;
+        slot.opcode[0] = state.memory[state.pc];
+        slot.opcode[1] = state.memory[uint16_t(state.pc + 1)];
+        slot.opcode[2] = state.memory[uint16_t(state.pc + 2)];
+        slot.a = state.a;
+        slot.b = state.b;
+        slot.c = state.c;
+        slot.d = state.d;
+        slot.e = state.e;
+        slot.h = state.h;
+        slot.l = state.l;
+        slot.flags = uint8_t(state.cc.z | state.cc.s << 1 | state.cc.p << 2 | state.cc.cy << 3 | state.cc.ac << 4
+                             | (state.int_enable ? TRACE_FLAG_IE : 0));
+        slot.reserved = 0;
+        header->written = ++written;
+    }
+
+    /**
+     * @brief Stops recording and unmaps the file. Only once the emulation thread no longer calls record().
+     */
+    void close();
+
+private:
+    bool open();
+
+    QString path;
+    uint64_t capacity;
+    QFile file;
+    uchar* mapping;
+    trace_file_header* header;
+    trace_record* records;
+    uint64_t mask;
+    uint64_t written;
+    std::atomic<bool> active;
+};
+
+#endif // INSTRUCTIONTRACE_H
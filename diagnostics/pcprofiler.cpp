@@ -0,0 +1,283 @@
+#include "pcprofiler.h"
+#include "../disassembler/disassembler.h"
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr int ADDRESS_SPACE = 0x10000;
+constexpr double CPU_CLOCK_HZ = 2000000.0;
+
+// Jumps, calls, returns, restarts, PCHL and HLT end a basic block
+bool endsBlock(uint8_t opcode) {
+    switch (opcode & 0xc7) {
+    case 0xc0: // Rcc
+    case 0xc2: // Jcc
+    case 0xc4: // Ccc
+    case 0xc7: // RST
+        return true;
+    }
+    switch (opcode) {
+    case 0xc3: case 0xcb:                       // JMP
+    case 0xc9: case 0xd9:                       // RET
+    case 0xcd: case 0xdd: case 0xed: case 0xfd: // CALL
+    case 0xe9:                                  // PCHL
+    case 0x76:                                  // HLT
+        return true;
+    }
+    return false;
+}
+
+// Flame graph frames are routine entry points, named by how they were entered
+constexpr const char* ROOT_NAME = "main";
+
+struct Block {
+    uint16_t first;
+    uint16_t last;       // Address of the block's last instruction
+    uint64_t executions; // Times the block was entered
+    uint64_t instructions;
+    uint64_t cycles;
+};
+
+} // namespace
+
+const std::array<PcProfiler::Flow, 256> PcProfiler::FLOW = [] {
+    std::array<Flow, 256> flow;
+    for (int opcode = 0; opcode < 256; ++opcode) {
+        switch (opcode & 0xc7) {
+        case 0xc4: flow[opcode] = Flow::Call; break;    // Ccc
+        case 0xc7: flow[opcode] = Flow::Restart; break; // RST
+        case 0xc0: flow[opcode] = Flow::Return; break;  // Rcc
+        default: flow[opcode] = Flow::None; break;
+        }
+    }
+    flow[0xcd] = flow[0xdd] = flow[0xed] = flow[0xfd] = Flow::Call;
+    flow[0xc9] = flow[0xd9] = Flow::Return;
+    return flow;
+}();
+
+void PcProfiler::reset() {
+    if (!counters) {
+        counters.reset(new Counter[ADDRESS_SPACE]);
+    }
+    std::memset(counters.get(), 0, sizeof(Counter) * ADDRESS_SPACE);
+
+    tree.clear();
+    tree.push_back({ 0, 0, Kind::Root, 0 });
+    children.clear();
+    depth = 0;
+    current = 0;
+    elapsed = 0;
+    currentSince = 0;
+}
+
+void PcProfiler::followFlow(uint16_t pc, uint8_t opcode, uint16_t nextPc) {
+    switch (FLOW[opcode]) {
+    case Flow::Call:
+        if (nextPc != uint16_t(pc + 3)) { // Taken
+            enter(nextPc, Kind::Call, uint16_t(pc + 3));
+        }
+        break;
+    case Flow::Restart:
+        enter(nextPc, Kind::Restart, uint16_t(pc + 1));
+        break;
+    case Flow::Return:
+        if (nextPc != uint16_t(pc + 1)) { // Taken
+            leave(nextPc);
+        }
+        break;
+    case Flow::None:
+        break;
+    }
+}
+
+void PcProfiler::enter(uint16_t address, Kind kind, uint16_t returnPc) {
+    const uint64_t key = uint64_t(current) << 24 | uint64_t(kind) << 16 | address;
+    uint32_t node = current;
+    const auto found = children.find(key);
+    if (found != children.end()) {
+        node = found->second;
+    } else if (tree.size() < MAX_NODES) {
+        node = uint32_t(tree.size());
+        tree.push_back({ current, address, kind, 0 });
+        children.emplace(key, node);
+    }
+
+    if (depth == MAX_DEPTH) {
+        // Runaway recursion or a stack the game unwinds by hand; forget the outermost frame
+        std::memmove(stack, stack + 1, sizeof(Frame) * (MAX_DEPTH - 1));
+        --depth;
+    }
+    stack[depth++] = { current, returnPc };
+    tree[current].cycles += elapsed - currentSince;
+    currentSince = elapsed;
+    current = node;
+}
+
+void PcProfiler::leave(uint16_t returnPc) {
+    // Match by return address, so frames whose return address the game popped
+    // itself are unwound too. A RET that matches no frame is a computed jump.
+    for (int i = depth - 1; i >= 0; --i) {
+        if (stack[i].returnPc == returnPc) {
+            tree[current].cycles += elapsed - currentSince;
+            currentSince = elapsed;
+            current = stack[i].caller;
+            depth = i;
+            return;
+        }
+    }
+}
+
+QString PcProfiler::frameName(const Node& node) const {
+    switch (node.kind) {
+    case Kind::Root: return ROOT_NAME;
+    case Kind::Call: return QString::asprintf("sub_%04x", node.address);
+    case Kind::Restart: return QString::asprintf("rst%d", node.address / 8);
+    case Kind::Interrupt: return QString::asprintf("irq_rst%d", node.address / 8);
+    }
+    return QString();
+}
+
+// The routine running now has not been charged since it was entered
+uint64_t PcProfiler::selfCycles(uint32_t node) const {
+    return tree[node].cycles + (node == current ? elapsed - currentSince : 0);
+}
+
+bool PcProfiler::writeFoldedStacks(const QString& path) const {
+    if (tree.empty()) {
+        return false;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "Could not write folded stacks" << path << file.errorString();
+        return false;
+    }
+    QTextStream out(&file);
+    std::vector<uint32_t> chain;
+    size_t lines = 0;
+    for (uint32_t i = 0; i < tree.size(); ++i) {
+        const uint64_t cycles = selfCycles(i);
+        if (!cycles) {
+            continue;
+        }
+        chain.clear();
+        for (uint32_t node = i; node != 0; node = tree[node].parent) {
+            chain.push_back(node);
+        }
+        QString line = ROOT_NAME;
+        for (auto node = chain.rbegin(); node != chain.rend(); ++node) {
+            line += ';';
+            line += frameName(tree[*node]);
+        }
+        out << line << ' ' << QString::number(cycles) << '\n';
+        ++lines;
+    }
+    qDebug() << lines << "call chains written to" << path;
+    return true;
+}
+
+bool PcProfiler::writeReport(const QString& path, const uint8_t* memory, int blocks) const {
+    if (!counters || !memory) {
+        return false;
+    }
+
+    // The disassembler wants a writable buffer with room for operands past 0xffff
+    std::vector<unsigned char> code(memory, memory + ADDRESS_SPACE);
+    code.resize(ADDRESS_SPACE + 2, 0);
+    char text[64];
+
+    // Walk the executed addresses in order. A block continues into the next
+    // instruction while it falls through and runs exactly as often; a
+    // different count means something jumps into the middle.
+    std::vector<Block> found;
+    uint64_t totalCycles = 0;
+    uint64_t totalInstructions = 0;
+    for (int pc = 0; pc < ADDRESS_SPACE;) {
+        const Counter& counter = counters[pc];
+        if (!counter.executions) {
+            ++pc;
+            continue;
+        }
+        Block block = { uint16_t(pc), uint16_t(pc), counter.executions, 0, 0 };
+        int next = pc;
+        for (;;) {
+            const Counter& current = counters[next];
+            block.last = uint16_t(next);
+            block.instructions += current.executions;
+            block.cycles += current.cycles;
+            const int length = disassemble_opcode_string(code.data(), next, text, sizeof(text));
+            const int following = next + length;
+            if (endsBlock(code[next]) || following >= ADDRESS_SPACE
+                || counters[following].executions != block.executions) {
+                next = following;
+                break;
+            }
+            next = following;
+        }
+        totalCycles += block.cycles;
+        totalInstructions += block.instructions;
+        found.push_back(block);
+        pc = next;
+    }
+    if (found.empty()) {
+        return false;
+    }
+
+    std::sort(found.begin(), found.end(), [](const Block& a, const Block& b) { return a.cycles > b.cycles; });
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "Could not write profile report" << path << file.errorString();
+        return false;
+    }
+    QTextStream out(&file);
+    out << QString::asprintf("%llu instructions, %llu cycles (%.1f s of emulated CPU time) in %zu basic blocks\n",
+                             static_cast<unsigned long long>(totalInstructions),
+                             static_cast<unsigned long long>(totalCycles), totalCycles / CPU_CLOCK_HZ, found.size());
+    // Time inside the scanline interrupt handlers, including everything they call
+    uint64_t interruptCycles[8] = {};
+    for (uint32_t i = 0; i < tree.size(); ++i) {
+        for (uint32_t node = i; node != 0; node = tree[node].parent) {
+            if (tree[node].kind == Kind::Interrupt) {
+                interruptCycles[(tree[node].address / 8) & 7] += selfCycles(i);
+                break;
+            }
+        }
+    }
+    for (int n = 0; n < 8; ++n) {
+        if (interruptCycles[n]) {
+            out << QString::asprintf("Interrupt handler RST %d: %.1f%% of cycles, including its callees\n", n,
+                                     100.0 * interruptCycles[n] / totalCycles);
+        }
+    }
+    out << "\n";
+
+    out << "Rank  Block      Cycles        Share  Cumulative  Entered     Cycles/entry\n";
+
+    double cumulative = 0.0;
+    const int listed = std::min<int>(blocks, int(found.size()));
+    for (int rank = 0; rank < listed; ++rank) {
+        const Block& block = found[rank];
+        const double share = 100.0 * block.cycles / totalCycles;
+        cumulative += share;
+        out << QString::asprintf("%4d  %04x-%04x %-12llu %5.1f%%  %9.1f%%  %-10llu  %.1f\n", rank + 1, block.first,
+                                 block.last, static_cast<unsigned long long>(block.cycles), share, cumulative,
+                                 static_cast<unsigned long long>(block.executions),
+                                 double(block.cycles) / block.executions);
+
+        // Per-instruction cycle breakdown of the block
+        for (int pc = block.first; pc <= block.last;) {
+            const int length = disassemble_opcode_string(code.data(), pc, text, sizeof(text));
+            out << QString::asprintf("                %-24s %12llu cycles\n", text,
+                                     static_cast<unsigned long long>(counters[pc].cycles));
+            pc += length;
+        }
+    }
+
+    qDebug() << "Profile of" << totalInstructions << "instructions written to" << path;
+    return true;
+}
@@ -0,0 +1,117 @@
+#ifndef PCPROFILER_H
+#define PCPROFILER_H
+
+#include <QString>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Counts executed instructions and cycles per program address of the emulated game.
+ *
+ * Counting adds two increments into a flat 64K table per instruction. The
+ * report groups the counted addresses into basic blocks, ranks them by
+ * cycles and lists each block with the disassembler's mnemonics, so the
+ * ROM routines that use up the frame budget stand out.
+ *
+ * The profiler also keeps a shadow call stack, fed by CALL, RST, RET and
+ * interrupt entry, and charges every instruction's cycles to the full
+ * emulated call chain. writeFoldedStacks() exports those chains in the
+ * folded format read by flame graph tools.
+ */
+class PcProfiler {
+public:
+    static constexpr int DEFAULT_REPORT_BLOCKS = 40;
+    static constexpr int MAX_DEPTH = 64;         ///< Deeper calls drop the outermost shadow frame
+    static constexpr size_t MAX_NODES = 1 << 16; ///< Call chains beyond this are charged to their caller
+
+    PcProfiler() = default;
+    PcProfiler(const PcProfiler&) = delete;
+    PcProfiler& operator=(const PcProfiler&) = delete;
+
+    /**
+     * @brief Zeroes every counter and empties the call tree, allocating the table on first use.
+     */
+    void reset();
+
+    /**
+     * @brief Adds one execution of the instruction at pc. Only after reset().
+     * @param opcode The instruction's first byte.
+     * @param nextPc PC after it executed, which tells taken calls and returns from untaken ones.
+     */
+    void count(uint16_t pc, uint8_t opcode, uint16_t nextPc, int cycles) {
+        Counter& counter = counters[pc];
+        ++counter.executions;
+        counter.cycles += cycles;
+        elapsed += cycles;
+        if (FLOW[opcode] != Flow::None) {
+            followFlow(pc, opcode, nextPc);
+        }
+    }
+
+    /**
+     * @brief Enters the handler of a hardware interrupt. Call before the RST is delivered.
+     * @param returnPc The interrupted PC, which the handler's RET returns to.
+     */
+    void interrupt(int number, uint16_t returnPc) {
+        enter(uint16_t(8 * number), Kind::Interrupt, returnPc);
+    }
+
+    /**
+     * @brief Writes the hottest basic blocks as text.
+     * @param memory The 64K address space the counted program ran from.
+     * @param blocks Number of blocks listed.
+     * @return False if the file could not be written, nothing was counted or memory is null.
+     */
+    bool writeReport(const QString& path, const uint8_t* memory, int blocks = DEFAULT_REPORT_BLOCKS) const;
+
+    /**
+     * @brief Writes one "caller;callee;... cycles" line per call chain.
+     * @return False if the file could not be written or nothing was counted.
+     */
+    bool writeFoldedStacks(const QString& path) const;
+
+private:
+    struct Counter {
+        uint64_t executions;
+        uint64_t cycles;
+    };
+
+    enum class Flow : uint8_t { None, Call, Restart, Return };
+    enum class Kind : uint8_t { Root, Call, Restart, Interrupt };
+
+    // A call chain: the path from the root to this node
+    struct Node {
+        uint32_t parent;
+        uint16_t address; ///< Entry address of the routine
+        Kind kind;
+        uint64_t cycles;  ///< Spent in this routine itself, not in its callees
+    };
+
+    struct Frame {
+        uint32_t caller;  ///< Node to go back to
+        uint16_t returnPc;
+    };
+
+    static const std::array<Flow, 256> FLOW;
+
+    void followFlow(uint16_t pc, uint8_t opcode, uint16_t nextPc);
+    void enter(uint16_t address, Kind kind, uint16_t returnPc);
+    void leave(uint16_t returnPc);
+    QString frameName(const Node& node) const;
+    uint64_t selfCycles(uint32_t node) const;
+
+    std::unique_ptr<Counter[]> counters; ///< Indexed by PC
+
+    std::vector<Node> tree;
+    std::unordered_map<uint64_t, uint32_t> children; ///< (parent, kind, address) -> node
+    Frame stack[MAX_DEPTH];
+    int depth = 0;
+    uint32_t current = 0;
+    uint64_t elapsed = 0;       ///< Cycles counted so far
+    uint64_t currentSince = 0;  ///< elapsed when current was entered; charged to it on the next switch
+};
+
+#endif // PCPROFILER_H
@@ -0,0 +1,24 @@
+#include "startuptimeline.h"
+#include <QDebug>
+#include <QElapsedTimer>
+
+namespace {
+
+QElapsedTimer& startupClock() {
+    static QElapsedTimer clock;
+    return clock;
+}
+
+} // namespace
+
+void StartupTimeline::start() {
+    startupClock().start();
+}
+
+double StartupTimeline::elapsedMs() {
+    return startupClock().isValid() ? startupClock().nsecsElapsed() / 1e6 : 0.0;
+}
+
+void StartupTimeline::mark(const char* event) {
+    qDebug("[startup] %8.1f ms  %s", elapsedMs(), event);
+}
@@ -0,0 +1,29 @@
+#ifndef STARTUPTIMELINE_H
+#define STARTUPTIMELINE_H
+
+/**
+ * @brief Timestamps of the startup milestones, logged relative to main().
+ *
+ * Compare the log of two builds to see what moved on or off the path to
+ * the first frame.
+ */
+namespace StartupTimeline {
+
+/**
+ * @brief Starts the clock; call first thing in main().
+ */
+void start();
+
+/**
+ * @brief Logs a milestone with the time since start(). Safe from any thread.
+ */
+void mark(const char* event);
+
+/**
+ * @brief Milliseconds since start().
+ */
+double elapsedMs();
+
+} // namespace StartupTimeline
+
+#endif // STARTUPTIMELINE_H
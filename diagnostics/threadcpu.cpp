@@ -0,0 +1,116 @@
+#include "threadcpu.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace ThreadCpu {
+
+namespace {
+
+struct Entry {
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint32_t> generation{ 0 };
+#ifdef __linux__
+    std::atomic<clockid_t> clock{ -1 }; ///< -1 while no live thread holds the entry
+#endif
+    std::thread::id thread; ///< Guarded by registryMutex, like live
+    bool live = false;
+};
+
+std::mutex registryMutex;
+Entry entries[MAX_THREADS];
+std::atomic<int> registered(0); // Entries below this are in use or kept for reuse
+
+// The live entry of the calling thread, or null. Caller holds registryMutex.
+Entry* findCurrent(int n) {
+    const std::thread::id self = std::this_thread::get_id();
+    for (int i = 0; i < n; ++i) {
+        if (entries[i].live && entries[i].thread == self) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+void registerCurrentThread(const char* name) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    const int n = registered.load(std::memory_order_relaxed);
+    Entry* entry = findCurrent(n);
+
+    // A thread that replaces an exited one of the same name (the emulator
+    // and video timer threads of a new game) takes over its entry
+    for (int i = 0; !entry && i < n; ++i) {
+        const char* existing = entries[i].name.load(std::memory_order_relaxed);
+        if (!entries[i].live && existing && std::strcmp(existing, name) == 0) {
+            entry = &entries[i];
+        }
+    }
+    if (!entry && n < MAX_THREADS) {
+        entry = &entries[n];
+        registered.store(n + 1, std::memory_order_release);
+    }
+    if (!entry) {
+        return;
+    }
+
+    entry->name.store(name, std::memory_order_relaxed);
+    entry->thread = std::this_thread::get_id();
+    entry->live = true;
+#ifdef __linux__
+    // Refreshed even for a known thread: the id of a joined thread is handed
+    // out again, so a match may be an entry its thread never unregistered
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) != 0) {
+        clock = -1;
+    }
+    if (entry->clock.exchange(clock, std::memory_order_relaxed) != clock) {
+        entry->generation.fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+}
+
+void unregisterCurrentThread() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (Entry* entry = findCurrent(registered.load(std::memory_order_relaxed))) {
+        entry->live = false;
+#ifdef __linux__
+        entry->clock.store(-1, std::memory_order_relaxed);
+#endif
+        entry->generation.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int count() {
+    return registered.load(std::memory_order_acquire);
+}
+
+const char* name(int index) {
+    return entries[index].name.load(std::memory_order_relaxed);
+}
+
+uint32_t generation(int index) {
+    return entries[index].generation.load(std::memory_order_relaxed);
+}
+
+int64_t cpuNs(int index) {
+#ifdef __linux__
+    const clockid_t clock = entries[index].clock.load(std::memory_order_relaxed);
+    timespec time;
+    if (clock != -1 && clock_gettime(clock, &time) == 0) {
+        return int64_t(time.tv_sec) * 1000000000LL + time.tv_nsec;
+    }
+#else
+    (void)index;
+#endif
+    return -1;
+}
+
+} // namespace ThreadCpu
@@ -0,0 +1,55 @@
+#ifndef THREADCPU_H
+#define THREADCPU_H
+
+#include <cstdint>
+
+/**
+ * @brief CPU time used by each of the emulator's named threads.
+ *
+ * A thread registers itself once; afterwards any thread can read how much
+ * CPU time it has used, without the registered thread doing anything.
+ * A thread that exits unregisters first, and a later thread registering
+ * under the same name takes over its entry, so threads that are recreated
+ * for every game do not use up the table. Only Linux reports times;
+ * elsewhere cpuNs() is always -1.
+ */
+namespace ThreadCpu {
+
+constexpr int MAX_THREADS = 8;
+
+/**
+ * @brief Adds the calling thread under the given name (a string literal).
+ *
+ * Registering the same thread again only renames it.
+ */
+void registerCurrentThread(const char* name);
+
+/**
+ * @brief Removes the calling thread; call before it exits.
+ */
+void unregisterCurrentThread();
+
+/**
+ * @brief Number of registered threads. Safe from any thread.
+ */
+int count();
+
+const char* name(int index);
+
+/**
+ * @brief Changes whenever the entry moves to another thread or loses its thread.
+ *
+ * CPU times read under different generations belong to different threads
+ * and must not be subtracted.
+ */
+uint32_t generation(int index);
+
+/**
+ * @brief CPU time used by a registered thread so far, in nanoseconds.
+ * @return -1 if the system cannot tell.
+ */
+int64_t cpuNs(int index);
+
+} // namespace ThreadCpu
+
+#endif // THREADCPU_H
@@ -0,0 +1,56 @@
+#ifndef TRACERECORD_H
+#define TRACERECORD_H
+
+/**
+ * @brief On-disk layout of an instruction trace, shared by the emulator and tools/tracedecode.
+ *
+ * The file is a header followed by a ring of capacity fixed-size records.
+ * written counts every record ever stored, so the oldest one still in the
+ * file is at index (written - capacity) when the ring has wrapped. All
+ * fields are little-endian, as written by the host.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "SI8080TR"
+#define TRACE_VERSION 1
+
+// Flag bits, in the order PUSH PSW stores them
+#define TRACE_FLAG_Z  0x01
+#define TRACE_FLAG_S  0x02
+#define TRACE_FLAG_P  0x04
+#define TRACE_FLAG_CY 0x08
+#define TRACE_FLAG_AC 0x10
+#define TRACE_FLAG_IE 0x80 // Interrupts enabled
+
+typedef struct trace_file_header {
+    char       magic[8];     // TRACE_MAGIC, not terminated
+    uint32_t   version;      // TRACE_VERSION
+    uint32_t   record_size;  // sizeof(trace_record)
+    uint64_t   capacity;     // Records in the ring, a power of two
+    uint64_t   written;      // Records stored since the trace was started
+} trace_file_header;
+
+// CPU state just before the instruction at pc executes
+typedef struct trace_record {
+    uint64_t   cycle;        // Total CPU cycles since power-on
+    uint16_t   pc;
+    uint16_t   sp;
+    uint8_t    opcode[3];    // Instruction bytes; unused operand bytes are whatever follows in memory
+    uint8_t    a, b, c, d, e, h, l;
+    uint8_t    flags;        // TRACE_FLAG_* bits
+    uint8_t    reserved;
+} trace_record;
+
+#ifdef __cplusplus
+}
+
+static_assert(sizeof(trace_file_header) == 32, "trace header layout changed");
+static_assert(sizeof(trace_record) == 24, "trace record layout changed");
+#endif
+
+#endif // TRACERECORD_H
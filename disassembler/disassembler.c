@@ -3,6 +3,7 @@
  * Adapted from emulator101.com.
  */
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -10,11 +11,48 @@
 #include "disassembler.h"
 #include "../inputmanager/debugwrapper.h"
 
+// Where disasm_print writes while disassemble_opcode_string runs on this thread; NULL means the debug log
+static _Thread_local char *capture_buffer = NULL;
+static _Thread_local size_t capture_size = 0;
+static _Thread_local size_t capture_length = 0;
+
+static void disasm_print(const char *format, ...) {
+    char text[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (!capture_buffer) {
+        qdebug_log("%s", text);
+        return;
+    }
+    if (capture_length + 1 < capture_size) {
+        snprintf(capture_buffer + capture_length, capture_size - capture_length, "%s", text);
+        capture_length += strlen(capture_buffer + capture_length);
+    }
+}
+
+// Disassembles into a string instead of the debug log; safe from several threads at once
+int disassemble_opcode_string(unsigned char *opcode_buffer, int pc, char *out, size_t size) {
+    int opbytes;
+    if (size == 0) {
+        return disassemble_opcode(opcode_buffer, pc);
+    }
+    out[0] = '\0';
+    capture_buffer = out;
+    capture_size = size;
+    capture_length = 0;
+    opbytes = disassemble_opcode(opcode_buffer, pc);
+    capture_buffer = NULL;
+    return opbytes;
+}
+
 // Prints opcode for instruction disassembly
 int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
     unsigned char *code = &opcode_buffer[pc];
     int opbytes = 1;
-    qdebug_log("%04x ", pc);
+    disasm_print("%04x ", pc);
 
     // Structs for printing instructions 
     const char *adc_cases[] = {
@@ -71,7 +109,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x28: 
         case 0x30: 
         case 0x38:
-            qdebug_log("NOP");
+            disasm_print("NOP");
             break;
 
         // LXI cases
@@ -79,7 +117,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x11:
         case 0x21:
         case 0x31:
-            qdebug_log("LXI %s,#$%02x%02x",
+            disasm_print("LXI %s,#$%02x%02x",
             (*code == 0x01) ? "B" : (*code == 0x11) ? "D" : (*code == 0x21) ? "H" : "SP",
             code[2],
             code[1]);
@@ -89,7 +127,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         // STAX cases
         case 0x02:
         case 0x12:
-            qdebug_log("STAX %s",
+            disasm_print("STAX %s",
             (*code == 0x02) ? "B" : "D");
             break;
         
@@ -98,7 +136,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x13:
         case 0x23:
         case 0x33:
-            qdebug_log("INX %s",
+            disasm_print("INX %s",
             (*code == 0x03) ? "B" : (*code == 0x13) ? "D" : (*code == 0x23) ? "H" : "SP");
             break;
         
@@ -111,7 +149,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x2c:
         case 0x34:
         case 0x3c:
-            qdebug_log("INR %s",
+            disasm_print("INR %s",
             (*code == 0x04) ? "B" : (*code == 0x0c) ? "C" : (*code == 0x14) ? "D" : (*code == 0x1c) ? "E" : 
             (*code == 0x24) ? "H" : (*code == 0x2c) ? "L" : (*code == 0x34) ? "M" : "SP");
             break;
@@ -125,7 +163,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x2d:
         case 0x35:
         case 0x3d:
-            qdebug_log("DCR %s",
+            disasm_print("DCR %s",
             (*code == 0x05) ? "B" : (*code == 0x0d) ? "C" : (*code == 0x15) ? "D" : (*code == 0x1d) ? "E" : 
             (*code == 0x25) ? "H" : (*code == 0x2d) ? "L" : (*code == 0x35) ? "M" : "SP");
             break;
@@ -139,7 +177,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x2e:
         case 0x36:
         case 0x3e:
-            qdebug_log("MVI %s,#$%02x",
+            disasm_print("MVI %s,#$%02x",
             (*code == 0x06) ? "B" : (*code == 0x0e) ? "C" : (*code == 0x16) ? "D" : (*code == 0x1e) ? "E" : 
             (*code == 0x26) ? "H" : (*code == 0x2e) ? "L" : (*code == 0x36) ? "M" : "SP",
             code[1]);
@@ -151,14 +189,14 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x19:
         case 0x29:
         case 0x39:
-            qdebug_log("DAD %s",
+            disasm_print("DAD %s",
             (*code == 0x09) ? "B" : (*code == 0x19) ? "D" : (*code == 0x29) ? "H" : "SP");
             break;
         
         // LDAX cases
         case 0x0a:
         case 0x1a:
-            qdebug_log("LDAX %s",
+            disasm_print("LDAX %s",
             (*code == 0x0a) ? "B" : "D");
             break;
 
@@ -167,23 +205,23 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x1b:
         case 0x2b:
         case 0x3b:
-            qdebug_log("DCX %s",
+            disasm_print("DCX %s",
             (*code == 0x0b) ? "B" : (*code == 0x1b) ? "D" : (*code == 0x2b) ? "H" : "SP");
             break;
 
         // One-off cases between 0x00 - 0x40:
-        case 0x22: qdebug_log("SHLD $%02x%02x", code[2], code[1]); opbytes=3; break;
-        case 0x32: qdebug_log("STA  $%02x%02x", code[2], code[1]); opbytes=3; break;
-        case 0x07: qdebug_log("RLC"); break;
-        case 0x17: qdebug_log("RAL"); break;
-        case 0x27: qdebug_log("DAA"); break;
-        case 0x37: qdebug_log("STC"); break;
-        case 0x0f: qdebug_log("RRC"); break;
-        case 0x1f: qdebug_log("RAR"); break;
-        case 0x2a: qdebug_log("LHLD $%02x%02x", code[2], code[1]); opbytes=3; break;
-        case 0x2f: qdebug_log("CMA"); break;
-        case 0x3a: qdebug_log("LDA $%02x%02x", code[2], code[1]); opbytes=3; break;
-        case 0x3f: qdebug_log("CMC"); break;
+        case 0x22: disasm_print("SHLD $%02x%02x", code[2], code[1]); opbytes=3; break;
+        case 0x32: disasm_print("STA  $%02x%02x", code[2], code[1]); opbytes=3; break;
+        case 0x07: disasm_print("RLC"); break;
+        case 0x17: disasm_print("RAL"); break;
+        case 0x27: disasm_print("DAA"); break;
+        case 0x37: disasm_print("STC"); break;
+        case 0x0f: disasm_print("RRC"); break;
+        case 0x1f: disasm_print("RAR"); break;
+        case 0x2a: disasm_print("LHLD $%02x%02x", code[2], code[1]); opbytes=3; break;
+        case 0x2f: disasm_print("CMA"); break;
+        case 0x3a: disasm_print("LDA $%02x%02x", code[2], code[1]); opbytes=3; break;
+        case 0x3f: disasm_print("CMC"); break;
 
         // MOV cases
         case 0x40:
@@ -250,7 +288,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x7d:
         case 0x7e:
         case 0x7f:
-            qdebug_log("%s", mov_cases[*code - 0x40]);
+            disasm_print("%s", mov_cases[*code - 0x40]);
             break;
 
         // ADD cases
@@ -262,7 +300,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x85:
         case 0x86:
         case 0x87:
-            qdebug_log("%s", add_cases[*code - 0x80]);
+            disasm_print("%s", add_cases[*code - 0x80]);
             break;
         
         // ADC cases
@@ -274,7 +312,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x8d:
         case 0x8e:
         case 0x8f:
-            qdebug_log("%s", adc_cases[*code - 0x88]);
+            disasm_print("%s", adc_cases[*code - 0x88]);
             break;
         
         // SUB cases
@@ -286,7 +324,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x95:
         case 0x96:
         case 0x97:
-            qdebug_log("%s", sub_cases[*code - 0x90]);
+            disasm_print("%s", sub_cases[*code - 0x90]);
             break;
         
         // SBB cases 
@@ -298,7 +336,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0x9d:
         case 0x9e:
         case 0x9f:
-            qdebug_log("%s", sbb_cases[*code - 0x98]);
+            disasm_print("%s", sbb_cases[*code - 0x98]);
             break;
         
         // ANA cases
@@ -310,7 +348,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xa5:
         case 0xa6:
         case 0xa7:
-            qdebug_log("%s", ana_cases[*code - 0xa0]);
+            disasm_print("%s", ana_cases[*code - 0xa0]);
             break;
 
         // XRA cases
@@ -322,7 +360,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xad:
         case 0xae:
         case 0xaf:
-            qdebug_log("%s", xra_cases[*code - 0xa8]);
+            disasm_print("%s", xra_cases[*code - 0xa8]);
             break;
 
         // ORA cases
@@ -334,7 +372,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xb5:
         case 0xb6:
         case 0xb7:
-            qdebug_log("%s", ora_cases[*code - 0xb0]);
+            disasm_print("%s", ora_cases[*code - 0xb0]);
             break;
 
         // CMP cases
@@ -346,7 +384,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xbd:
         case 0xbe:
         case 0xbf:
-            qdebug_log("%s", cmp_cases[*code - 0xb8]);
+            disasm_print("%s", cmp_cases[*code - 0xb8]);
             break; 
         
         // POP cases
@@ -354,7 +392,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xd1:
         case 0xe1:
         case 0xf1:
-            qdebug_log("POP %s",
+            disasm_print("POP %s",
             (*code == 0xc1) ? "B" : (*code == 0xd1) ? "D" : (*code == 0xe1) ? "H" : "SP");
             break;
         
@@ -363,7 +401,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xd5:
         case 0xe5:
         case 0xf5:
-            qdebug_log("PUSH %s",
+            disasm_print("PUSH %s",
             (*code == 0xc5) ? "B" : (*code == 0xd5) ? "D" : (*code == 0xe5) ? "H" : "SP");
             break;
         
@@ -376,7 +414,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xef:
         case 0xf7:
         case 0xff:
-            qdebug_log("RST %s",
+            disasm_print("RST %s",
             (*code == 0xc7) ? "0" : (*code == 0xcf) ? "1" : (*code == 0xd7) ? "2" : (*code == 0xdf) ? "3" : 
             (*code == 0xe7) ? "4" : (*code == 0xef) ? "5" : (*code == 0xf7) ? "6" : "7");
             break;
@@ -404,7 +442,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xfa:
         case 0xfc:
         case 0xfd:
-            qdebug_log("%s $%02x%02x",
+            disasm_print("%s $%02x%02x",
             (*code == 0xc2) ? "JNZ" : (*code == 0xc3) ? "JMP" : (*code == 0xc4) ? "CNZ" : (*code == 0xca) ? "JZ" :
             (*code == 0xcb) ? "JMP" : (*code == 0xcc) ? "CZ" : (*code == 0xcd) ? "CALL" : (*code == 0xd2) ? "JNC" :
             (*code == 0xd4) ? "CNC" : (*code == 0xda) ? "JC" : (*code == 0xdc) ? "CC" : (*code == 0xdd) ? "CALL" :
@@ -426,7 +464,7 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
         case 0xee:
         case 0xf6:
         case 0xfe:
-            qdebug_log("%s $%02x",
+            disasm_print("%s $%02x",
             (*code == 0xc6) ? "ADI" : (*code == 0xce) ? "ACI" : (*code == 0xd3) ? "OUT" : (*code == 0xd6) ? "SUI" :
             (*code == 0xdb) ? "IN" : (*code == 0xde) ? "SBI" : (*code == 0xe6) ? "ANI" : (*code == 0xee) ? "XRI" :
             (*code == 0xf6) ? "ORI" : "CPI",
@@ -435,22 +473,22 @@ int disassemble_opcode(unsigned char *opcode_buffer, int pc) {
             break;
 
         // One-off cases between 0xc0 - 0xff:
-        case 0xc0: qdebug_log("RNZ"); break;
-        case 0xc8: qdebug_log("RZ"); break;
-        case 0xc9: qdebug_log("RET"); break;
-        case 0xd0: qdebug_log("RNC"); break;
-        case 0xd8: qdebug_log("RC");  break;
-        case 0xd9: qdebug_log("RET"); break;
-        case 0xe0: qdebug_log("RPO"); break;
-        case 0xe3: qdebug_log("XTHL"); break;
-        case 0xe8: qdebug_log("RPE"); break;
-        case 0xe9: qdebug_log("PCHL"); break;
-        case 0xeb: qdebug_log("XCHG"); break;
-        case 0xf0: qdebug_log("RP");  break;
-        case 0xf3: qdebug_log("DI");  break;
-        case 0xf8: qdebug_log("RM");  break;
-        case 0xf9: qdebug_log("SPHL"); break;
-        case 0xfb: qdebug_log("EI");  break;
+        case 0xc0: disasm_print("RNZ"); break;
+        case 0xc8: disasm_print("RZ"); break;
+        case 0xc9: disasm_print("RET"); break;
+        case 0xd0: disasm_print("RNC"); break;
+        case 0xd8: disasm_print("RC");  break;
+        case 0xd9: disasm_print("RET"); break;
+        case 0xe0: disasm_print("RPO"); break;
+        case 0xe3: disasm_print("XTHL"); break;
+        case 0xe8: disasm_print("RPE"); break;
+        case 0xe9: disasm_print("PCHL"); break;
+        case 0xeb: disasm_print("XCHG"); break;
+        case 0xf0: disasm_print("RP");  break;
+        case 0xf3: disasm_print("DI");  break;
+        case 0xf8: disasm_print("RM");  break;
+        case 0xf9: disasm_print("SPHL"); break;
+        case 0xfb: disasm_print("EI");  break;
     }
 
     return opbytes;
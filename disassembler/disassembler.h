@@ -23,6 +23,14 @@ typedef struct condition_codes {
     uint8_t    pad:3;  // Padding bits to make the struct 1 byte
 } condition_codes;    
 
+// Writes the hardware would ignore, counted instead of logged one by one
+typedef struct memory_violations {
+    uint32_t   rom_writes;          // Data writes below 0x2000
+    uint32_t   out_of_range_writes; // Writes at 0x4000 and above
+    uint32_t   stack_rom_writes;    // Pushes (CALL, RST, PUSH) that ran the stack down into ROM
+    uint16_t   last_address;        // Address of the most recent violation
+} memory_violations;
+
 typedef struct state_8080cpu {    
     uint8_t    a;           // Accumulator
     uint8_t    b;           // B Register
@@ -37,10 +45,14 @@ typedef struct state_8080cpu {
     condition_codes cc;     // Condition Codes (status flags)
     uint8_t     int_enable; // Interrupt Enable/Disable flag
     ioports_t   ioports;   // Input/ouput ports
+    memory_violations violations;
 } state_8080cpu;
 
 int disassemble_opcode(unsigned char *opcodebuffer, int pc);
 
+// Same as disassemble_opcode, but writes "pc MNEMONIC operands" into out. Thread-safe.
+int disassemble_opcode_string(unsigned char *opcodebuffer, int pc, char *out, size_t size);
+
 #endif // DISASSEMBLER_H
 
 #ifdef __cplusplus
@@ -12,6 +12,7 @@
 #include "emulator.h"
 #include "../disassembler/disassembler.h"
 #include "../inputmanager/debugwrapper.h"
+#include "../diagnostics/asynclog.h"
 
 const uint8_t cycles_8080[256] = {
     4, 10, 7, 5, 5, 7, 4, 4,  // 0x00 - 0x07
@@ -91,7 +92,9 @@ void unimplemented_instruction(state_8080cpu *state) {
     state->pc--; // Undo PC increment
 
     // Display error message along with the disassembled instruction
-    qdebug_log("Error: No instruction implemented at address %04x: ", state->pc);
+    // The disassembler prints synchronously, so let the queued log catch up first
+    ALOG_ERROR("Error: No instruction implemented at address %04x:", state->pc);
+    asynclog_flush();
     disassemble_opcode(state->memory, state->pc);  // Show the problematic instruction
     qdebug_log("\n");
 
@@ -110,19 +113,32 @@ void write_HL(state_8080cpu *state, uint8_t value) {
     write_memory(state, offset, value); 
 };
 
-// Writes to specified memory address unless address is ROM
+// Writes to specified memory address unless address is ROM.
+// Rejected writes are only counted; the emulator wrapper reports them once a second.
 void write_memory(state_8080cpu *state, uint16_t address, uint8_t value) {
     if (address < 0x2000) {
-        qdebug_log("Writing ROM not allowed on %x\n", address);
+        state->violations.rom_writes++;
+        state->violations.last_address = address;
         return;
      }
      if (address >= 0x4000) {
-        qdebug_log("Writing out of Space Invaders ROM not allowed on %x\n", address);
+        state->violations.out_of_range_writes++;
+        state->violations.last_address = address;
         return;
      }
      state->memory[address] = value;
 };
 
+// Writes a byte pushed onto the stack, counting a stack that has grown down into ROM separately
+void write_stack(state_8080cpu *state, uint16_t address, uint8_t value) {
+    if (address < 0x2000) {
+        state->violations.stack_rom_writes++;
+        state->violations.last_address = address;
+        return;
+    }
+    write_memory(state, address, value);
+};
+
 // Functions for handling multiple instances of similar instructions
 
 void handle_ADC(state_8080cpu *state, uint8_t *reg, uint8_t value) {
@@ -145,8 +161,8 @@ void handle_ANA(state_8080cpu *state, uint8_t value) {
 void handle_CALL(uint8_t conditional, state_8080cpu* state, uint8_t* opcode) {
     if (conditional) {
         uint16_t ret = state->pc+2;
-        write_memory(state, state->sp-1, (ret >> 8) & 0xff);
-        write_memory(state, state->sp-2, (ret & 0xff));
+        write_stack(state, state->sp-1, (ret >> 8) & 0xff);
+        write_stack(state, state->sp-2, (ret & 0xff));
         state->sp = state->sp - 2;
         state->pc = (opcode[2] << 8) | opcode[1];
     }
@@ -217,8 +233,8 @@ void handle_POP(uint8_t  *high, uint8_t *low, state_8080cpu *state) {
 };
 
 void handle_PUSH(uint8_t high, uint8_t low, state_8080cpu *state) {
-    state->memory[state->sp - 1] = high;
-    state->memory[state->sp - 2] = low;
+    write_stack(state, state->sp - 1, high);
+    write_stack(state, state->sp - 2, low);
     state->sp -= 2;
 };
 
@@ -695,13 +711,13 @@ int emulate_8080cpu(state_8080cpu *state) {
         case 0xe5: handle_PUSH(state->h, state->l, state); break; // PUSH H
         case 0xf5:                                                // PUSH PSW
             {
-                state->memory[state->sp - 1] = state->a;
+                write_stack(state, state->sp - 1, state->a);
                 uint8_t psw = (state->cc.z |
                             state->cc.s << 1 |
                             state->cc.p << 2 |
                             state->cc.cy << 3 |
                             state->cc.ac << 4);
-                state->memory[state->sp - 2] = psw;
+                write_stack(state, state->sp - 2, psw);
                 state->sp -= 2;
             }
             break;
@@ -995,8 +1011,8 @@ void generateInterrupt(state_8080cpu* state, int interrupt_num)
     //perform "PUSH PC"
     //qdebug_log("Pushing Program Counter: %04x\n", state->pc);
     uint16_t ret = state->pc;
-    write_memory(state, state->sp-1, (ret >> 8) & 0xff);
-    write_memory(state, state->sp-2, (ret & 0xff));
+    write_stack(state, state->sp-1, (ret >> 8) & 0xff);
+    write_stack(state, state->sp-2, (ret & 0xff));
     state->sp = state->sp - 2;
     //Set the PC to the low memory vector.
     //This is identical to an "RST interrupt_num" instruction.
@@ -20,6 +20,8 @@ void unimplemented_instruction(state_8080cpu *state);
 
 void write_memory(state_8080cpu *state, uint16_t address, uint8_t value);
 
+void write_stack(state_8080cpu *state, uint16_t address, uint8_t value);
+
 void flags_logicA(state_8080cpu *state);
 
 void flags_arithA(state_8080cpu *state, uint16_t res);
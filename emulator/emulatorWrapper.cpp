@@ -1,16 +1,60 @@
 #include "emulatorWrapper.h"
-#include "../outputmanager/outputManager.h"
+#include "../outputmanager/audiomixer.h"
 #include "io_bits.h"
+#include "invaders_rom.h"
+#include "../diagnostics/startuptimeline.h"
+#include "../diagnostics/asynclog.h"
+#include "../diagnostics/chrometrace.h"
+#include "../diagnostics/threadcpu.h"
 #include <qjsondocument.h>
 #include <qjsonobject.h>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QSaveFile>
 #include <QString>
+#include <cstring>
+#include <thread>
 
-#define INTERRUPT_INTERVAL 8333333
 #define MEMORY_SIZE 0x10000 // 64KB total memory
-#define CPU_CLOCK_HZ 2000000 // 2 MHz clock speed
 #define NS_PER_CYCLE 500 // Nanoseconds per clock cycle in 8080
+#define RAM_START 0x2000 // Work and video RAM, the only memory a snapshot needs
+#define RAM_SIZE 0x2000
+
+namespace {
+
+// Warm-start image: this header followed by the 8 KB of RAM
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t rom_hash;      // A snapshot only fits the ROM it was taken with
+    uint8_t dip_switches;   // ...and the lives/extra life settings the game read at boot
+    uint8_t a, b, c, d, e, h, l;
+    uint16_t sp, pc;
+    uint8_t z, s, p, cy, ac;
+    uint8_t int_enable;
+    uint8_t write02, write03, write04, write05, write06;
+    uint8_t shift0, shift1, shift_amt;
+    uint8_t cycles_used, next_interrupt, pending_interrupt;
+    uint32_t frame_cycle;
+    uint64_t total_cycles;
+};
+
+constexpr char SNAPSHOT_MAGIC[8] = { 'S', 'I', '8', '0', '8', '0', 'W', 'S' };
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+// FNV-1a over the compiled-in ROM
+constexpr uint32_t romHash() {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < INVADERS_ROM_SIZE; ++i) {
+        hash = (hash ^ INVADERS_ROM[i]) * 16777619u;
+    }
+    return hash;
+}
+constexpr uint32_t ROM_HASH = romHash();
+
+} // namespace
 
 // Static member initialization
 EmulatorWrapper* EmulatorWrapper::instance = nullptr;
@@ -24,16 +68,16 @@ EmulatorWrapper& EmulatorWrapper::getInstance() {
 }
 
 // Private constructor
-EmulatorWrapper::EmulatorWrapper() : running(false), ram(nullptr) {
+EmulatorWrapper::EmulatorWrapper() : running(false), emulating(false), ram(nullptr) {
     qDebug() << "Creating EmulatorWrapper...";
 
-    // Allocate memory and load ROM
+    // Allocate memory and copy in the ROM image compiled into the binary
     ram = create_mem_block(MEMORY_SIZE);
     if (!ram) {
         qCritical() << "Failed to allocate memory for RAM. Emulator cannot initialize.";
         throw std::runtime_error("Failed to allocate memory for RAM.");
     }
-    if (load_rom(ram, "invaders.rom") != 0) {
+    if (load_rom(ram, INVADERS_ROM, INVADERS_ROM_SIZE) != 0) {
         qCritical() << "Failed to load ROM into memory.";
         delete_mem_block(ram);
         throw std::runtime_error("Failed to load ROM into memory.");
@@ -44,6 +88,9 @@ EmulatorWrapper::EmulatorWrapper() : running(false), ram(nullptr) {
     state.memory = ram->mem;
     state.pc = 0;
     state.sp = 0;
+    state.violations = {};
+    reported_violations = {};
+    frames_since_report = 0;
 
     // Initialize IO ports
     state.ioports.read00 = 0b00001110; // Default state for port 0
@@ -61,14 +108,44 @@ EmulatorWrapper::EmulatorWrapper() : running(false), ram(nullptr) {
     shift1 = 0; // High register
     shift_amt = 0; // Shift amount
 
-    // Initialize timer for interrupts
-    previous_interrupt_time = std::chrono::high_resolution_clock::now();
-    previous_cycle_time = previous_interrupt_time;
+    // Initialize timing; interrupts are raised by the emulated beam position
+    previous_cycle_time = std::chrono::high_resolution_clock::now();
     cycles_used = 0;
-    interrupt_toggle = 0; // 0 = middle of screen, 1 = bottom of screen
+    frame_cycle = 0;
+    next_interrupt = 1;
+    pending_interrupt = 0;
+    total_cycles = 0;
+    cycle_count = 0;
+    instructions_executed = 0;
+    frame_trace_start = 0;
+    traced_input = 0;
+
+    // Sound port writes go straight onto the mixer's event ring
+    audioMixer = AudioMixer::getInstance();
+    audioMixer->setCycleClock(&cycle_count, CPU_CLOCK_HZ);
+
+    audio_paced = false;
+    cycle_budget = 0;
+    audio_wait_us = 0;
+    warm_start = false;
+    warm_start_file = QDir::currentPath() + "/warmstart.bin";
+    profiling = false;
+    profile_wanted = false;
+    profile_file = QDir::currentPath() + "/profile.txt";
+    profile_stacks_file = QDir::currentPath() + "/profile.folded";
 
     // Get extra life and score settings from settings file
     loadSettings();
+    if (audio_paced && audioMixer->isSilent()) {
+        qDebug() << "No audio output to pace the emulator; using the wall clock.";
+        audio_paced = false;
+    }
+    audioMixer->setPacing(audio_paced);
+
+    if (warm_start) {
+        warmStart();
+    }
+    StartupTimeline::mark(warm_start ? "emulator ready (warm start)" : "emulator ready (cold start)");
 
     qDebug() << "EmulatorWrapper initialized.";
 }
@@ -86,6 +163,25 @@ void EmulatorWrapper::loadSettings()
             QJsonDocument jsonDoc = QJsonDocument::fromJson(data);
             QJsonObject jsonObject = jsonDoc.object();
 
+            // "audio" lets the sound output clock the CPU instead of std::chrono
+            audio_paced = jsonObject["emulation_clock"].toString("wallclock") == "audio";
+            qDebug() << "Emulation clock:" << (audio_paced ? "audio" : "wallclock");
+
+            warm_start = jsonObject["warm_start"].toBool(false);
+            warm_start_file = jsonObject["warm_start_file"].toString(warm_start_file);
+
+            trace.configure(jsonObject["trace_file"].toString(QDir::currentPath() + "/trace.bin"),
+                            jsonObject["trace_records"].toInteger(InstructionTrace::DEFAULT_RECORDS));
+            if (jsonObject["instruction_trace"].toBool(false)) {
+                trace.setEnabled(true);
+            }
+
+            profile_wanted = jsonObject["profiler"].toBool(false);
+            profile_file = jsonObject["profile_file"].toString(profile_file);
+            profile_stacks_file = jsonObject["profile_stacks_file"].toString(profile_stacks_file);
+
+            host_counters.setEnabled(jsonObject["host_counters"].toBool(false));
+
             int lives = jsonObject["lives"].toInteger(3);
             int extra_life_at = jsonObject["extra_life_at"].toInteger(1000);
 
@@ -109,9 +205,139 @@ void EmulatorWrapper::loadSettings()
 
 }
 
+void EmulatorWrapper::warmStart() {
+    QElapsedTimer timer;
+    timer.start();
+    if (loadSnapshot(warm_start_file)) {
+        qDebug() << "Warm start from" << warm_start_file << "in" << timer.nsecsElapsed() / 1000 << "us";
+        return;
+    }
+
+    // No usable image yet: run the power-on wait flat out once and keep the result
+    runUntil(uint64_t(WARM_START_FRAMES) * CYCLES_PER_FRAME);
+    qDebug() << "Warm-start image built in" << timer.elapsed() << "ms";
+    if (!saveSnapshot(warm_start_file)) {
+        qWarning() << "Could not write warm-start image" << warm_start_file;
+    }
+}
+
+bool EmulatorWrapper::loadSnapshot(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (file.size() != qint64(sizeof(SnapshotHeader) + RAM_SIZE)) {
+        qWarning() << "Ignoring warm-start image of unexpected size:" << path;
+        return false;
+    }
+    const uchar* image = file.map(0, file.size());
+    if (!image) {
+        qWarning() << "Could not map warm-start image:" << path;
+        return false;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, image, sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SNAPSHOT_VERSION || header.header_size != sizeof(SnapshotHeader)) {
+        qWarning() << "Ignoring warm-start image in an unknown format:" << path;
+        return false;
+    }
+    if (header.rom_hash != ROM_HASH || header.dip_switches != state.ioports.read02) {
+        qDebug() << "Warm-start image was taken with another ROM or other settings; rebuilding it.";
+        return false;
+    }
+
+    std::memcpy(&state.memory[RAM_START], image + sizeof(SnapshotHeader), RAM_SIZE);
+    file.unmap(const_cast<uchar*>(image));
+
+    state.a = header.a;
+    state.b = header.b;
+    state.c = header.c;
+    state.d = header.d;
+    state.e = header.e;
+    state.h = header.h;
+    state.l = header.l;
+    state.sp = header.sp;
+    state.pc = header.pc;
+    state.cc.z = header.z;
+    state.cc.s = header.s;
+    state.cc.p = header.p;
+    state.cc.cy = header.cy;
+    state.cc.ac = header.ac;
+    state.int_enable = header.int_enable;
+    state.ioports.write02 = header.write02;
+    state.ioports.write04 = header.write04;
+    state.ioports.write06 = header.write06;
+    shift0 = header.shift0;
+    shift1 = header.shift1;
+    shift_amt = header.shift_amt;
+    cycles_used = header.cycles_used;
+    next_interrupt = header.next_interrupt;
+    pending_interrupt = header.pending_interrupt;
+    frame_cycle = header.frame_cycle;
+    total_cycles = header.total_cycles;
+    cycle_count.store(total_cycles, std::memory_order_release);
+
+    // Replay the sound latches so the mixer sees the same outputs as the game
+    audioMixer->postPortWrite(total_cycles, 3, state.ioports.write03, header.write03);
+    state.ioports.write03 = header.write03;
+    audioMixer->postPortWrite(total_cycles, 5, state.ioports.write05, header.write05);
+    state.ioports.write05 = header.write05;
+    return true;
+}
+
+bool EmulatorWrapper::saveSnapshot(const QString& path) const {
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(SnapshotHeader);
+    header.rom_hash = ROM_HASH;
+    header.dip_switches = state.ioports.read02;
+    header.a = state.a;
+    header.b = state.b;
+    header.c = state.c;
+    header.d = state.d;
+    header.e = state.e;
+    header.h = state.h;
+    header.l = state.l;
+    header.sp = state.sp;
+    header.pc = state.pc;
+    header.z = state.cc.z;
+    header.s = state.cc.s;
+    header.p = state.cc.p;
+    header.cy = state.cc.cy;
+    header.ac = state.cc.ac;
+    header.int_enable = state.int_enable;
+    header.write02 = state.ioports.write02;
+    header.write03 = state.ioports.write03;
+    header.write04 = state.ioports.write04;
+    header.write05 = state.ioports.write05;
+    header.write06 = state.ioports.write06;
+    header.shift0 = shift0;
+    header.shift1 = shift1;
+    header.shift_amt = shift_amt;
+    header.cycles_used = cycles_used;
+    header.next_interrupt = next_interrupt;
+    header.pending_interrupt = pending_interrupt;
+    header.frame_cycle = frame_cycle;
+    header.total_cycles = total_cycles;
+
+    // Written to a temporary file and renamed, so a crash never leaves half an image
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&state.memory[RAM_START]), RAM_SIZE);
+    return file.commit();
+}
+
 // Destructor
 EmulatorWrapper::~EmulatorWrapper() {
     qDebug() << "Destroying EmulatorWrapper...";
+    audioMixer->setPacing(false);
+    audioMixer->setCycleClock(nullptr, CPU_CLOCK_HZ);
     cleanup(); // Ensure all resources are released
 
     // Reset CPU state
@@ -130,6 +356,125 @@ const uint8_t* EmulatorWrapper::getVideoMemory() const {
 }
 
 
+uint64_t EmulatorWrapper::getCycleCount() const {
+    return cycle_count.load(std::memory_order_acquire);
+}
+
+void EmulatorWrapper::advanceBeam(int cycles) {
+    total_cycles += cycles;
+    frame_cycle += cycles;
+
+    if (next_interrupt == 1 && frame_cycle >= MID_SCREEN_CYCLE) {
+        pending_interrupt = 1;
+        next_interrupt = 2;
+    } else if (next_interrupt == 2 && frame_cycle >= END_OF_SCREEN_CYCLE) {
+        pending_interrupt = 2;
+        next_interrupt = 1;
+    }
+    if (frame_cycle >= CYCLES_PER_FRAME) {
+        frame_cycle -= CYCLES_PER_FRAME;
+        if (ChromeTrace::enabled()) {
+            if (frame_trace_start != 0) {
+                ChromeTrace::complete("emulated frame", frame_trace_start);
+            }
+            frame_trace_start = ChromeTrace::now();
+        }
+        frame_budget.endFrame();
+        host_counters.endFrame(instructions_executed);
+        if (++frames_since_report >= VIOLATION_REPORT_FRAMES) {
+            reportViolations();
+        }
+        if (profile_wanted.load(std::memory_order_relaxed) != profiling) {
+            applyProfiling();
+        }
+    }
+
+    cycle_count.store(total_cycles, std::memory_order_release);
+}
+
+void EmulatorWrapper::reportViolations() {
+    frames_since_report = 0;
+    const memory_violations& now = state.violations;
+    const uint32_t rom = now.rom_writes - reported_violations.rom_writes;
+    const uint32_t out_of_range = now.out_of_range_writes - reported_violations.out_of_range_writes;
+    const uint32_t stack = now.stack_rom_writes - reported_violations.stack_rom_writes;
+    if (rom == 0 && out_of_range == 0 && stack == 0) {
+        return;
+    }
+    ALOG_WARN("Ignored memory writes: %u to ROM, %u above 0x3fff, %u stack pushes into ROM (last at %04x)",
+              rom, out_of_range, stack, now.last_address);
+    reported_violations = now;
+}
+
+bool EmulatorWrapper::setTracing(bool enable) {
+    return trace.setEnabled(enable);
+}
+
+void EmulatorWrapper::setProfiling(bool enable) {
+    profile_wanted.store(enable, std::memory_order_relaxed);
+}
+
+// Runs on the emulation thread between frames, so the counters are never touched concurrently
+void EmulatorWrapper::applyProfiling() {
+    profiling = profile_wanted.load(std::memory_order_relaxed);
+    if (profiling) {
+        profiler.reset();
+        qDebug() << "Profiling the game's execution";
+    } else {
+        writeProfile();
+    }
+}
+
+void EmulatorWrapper::writeProfile() {
+    profiler.writeReport(profile_file, state.memory);
+    profiler.writeFoldedStacks(profile_stacks_file);
+}
+
+void EmulatorWrapper::executeInstruction() {
+    if (trace.enabled()) {
+        trace.record(state, total_cycles);
+    }
+    unsigned char* opcode = &state.memory[state.pc];
+    if (*opcode == 0xd3) { // OUT instruction
+        handleOUT(opcode);
+    } else if (*opcode == 0xdb) { // IN instruction
+        handleIN(opcode);
+    }
+    const uint16_t pc = state.pc;
+    const uint8_t instruction = *opcode;
+    cycles_used = emulate_8080cpu(&state);
+    ++instructions_executed;
+    frame_budget.count(pc, instruction, state.pc, state.sp, cycles_used);
+    if (profiling) {
+        profiler.count(pc, instruction, state.pc, cycles_used);
+    }
+    advanceBeam(cycles_used);
+}
+
+// Returns true once there are granted cycles to spend
+bool EmulatorWrapper::waitForAudioCredit() {
+    if (cycle_budget > 0) {
+        return true;
+    }
+    cycle_budget += audioMixer->takeCycleCredit();
+    if (cycle_budget > 0) {
+        audio_wait_us = 0;
+        return true;
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(AUDIO_WAIT_US));
+    audio_wait_us += AUDIO_WAIT_US;
+    if (audio_wait_us >= AUDIO_TIMEOUT_US) {
+        // No audio device is pulling samples, so nothing would ever grant cycles
+        qWarning() << "Audio output is not running; falling back to wall-clock pacing.";
+        audio_paced = false;
+        audioMixer->setPacing(false);
+        host_counters.setPacingSpin(true);
+        previous_cycle_time = std::chrono::high_resolution_clock::now();
+    }
+    return false;
+}
+
 // Emulator cycle execution
 void EmulatorWrapper::runCycle() {
     // Wait if debug paused
@@ -138,28 +483,41 @@ void EmulatorWrapper::runCycle() {
         pauseCondition.wait(lock, [this]() { return !paused; });
     }
 
-    auto current_timepoint = std::chrono::high_resolution_clock::now();
-
-    if (current_timepoint - previous_cycle_time >= std::chrono::nanoseconds(cycles_used * NS_PER_CYCLE)) {
-        previous_cycle_time = current_timepoint;
+    if (audio_paced) {
+        if (!waitForAudioCredit()) {
+            return;
+        }
+        executeInstruction();
+        cycle_budget -= cycles_used;
+    } else {
+        auto current_timepoint = std::chrono::high_resolution_clock::now();
 
-        unsigned char* opcode = &state.memory[state.pc];
-        if (*opcode == 0xd3) { // OUT instruction
-            handleOUT(opcode);
-        } else if (*opcode == 0xdb) { // IN instruction
-            handleIN(opcode);
+        if (current_timepoint - previous_cycle_time >= std::chrono::nanoseconds(cycles_used * NS_PER_CYCLE)) {
+            previous_cycle_time = current_timepoint;
+            executeInstruction();
         }
-        cycles_used = emulate_8080cpu(&state);
     }
 
-    if ((current_timepoint - previous_interrupt_time) > std::chrono::nanoseconds(INTERRUPT_INTERVAL)) {
-        if (state.int_enable) {
-            int interrupt_num = interrupt_toggle + 1;
-            generateInterrupt(&state, interrupt_num);
-            state.int_enable = false;
-            previous_interrupt_time = current_timepoint;
-            interrupt_toggle ^= 1;
+    serviceInterrupt();
+}
+
+void EmulatorWrapper::serviceInterrupt() {
+    if (pending_interrupt && state.int_enable) {
+        if (profiling) {
+            profiler.interrupt(pending_interrupt, state.pc);
         }
+        generateInterrupt(&state, pending_interrupt);
+        frame_budget.interrupt(state.sp);
+        state.int_enable = false;
+        pending_interrupt = 0;
+    }
+}
+
+void EmulatorWrapper::runUntil(uint64_t cycle) {
+    host_counters.setPacingSpin(false);
+    while (total_cycles < cycle) {
+        executeInstruction();
+        serviceInterrupt();
     }
 }
 
@@ -178,6 +536,19 @@ void EmulatorWrapper::cleanup() {
     }
     pauseCondition.notify_all();
 
+    // Let the loop finish its current instruction before the state goes away
+    {
+        std::unique_lock<std::mutex> lock(pauseMutex);
+        pauseCondition.wait(lock, [this]() { return !emulating; });
+    }
+    reportViolations();
+    if (profiling) {
+        writeProfile(); // The report disassembles the ROM, so before memory is released
+        profiling = false;
+    }
+
+    trace.close(); // Safe now that record() cannot be running
+
     // Release memory resources
     if (ram) {
         delete_mem_block(ram);
@@ -187,12 +558,20 @@ void EmulatorWrapper::cleanup() {
 
     // Reset CPU state
     state = {};
+    reported_violations = {};
     qDebug() << "EmulatorWrapper cleanup completed.";
 }
 
 // Start the emulation loop
 void EmulatorWrapper::startEmulation() {
     running = true;
+    {
+        std::lock_guard<std::mutex> lock(pauseMutex);
+        emulating = true;
+    }
+    ChromeTrace::setThreadName("emulator");
+    ThreadCpu::registerCurrentThread("emulator");
+    host_counters.setPacingSpin(!audio_paced); // The wall clock busy-waits before every instruction
     qDebug() << "Starting emulation...";
     while (running) {
         // Wait if paused and not stepping
@@ -209,6 +588,13 @@ void EmulatorWrapper::startEmulation() {
             paused = true;
         }
     }
+    ThreadCpu::unregisterCurrentThread(); // A new game runs on a new thread
+
+    {
+        std::lock_guard<std::mutex> lock(pauseMutex);
+        emulating = false;
+    }
+    pauseCondition.notify_all();
 }
 
 void EmulatorWrapper::handleOUT(unsigned char* opcode) {
@@ -218,7 +604,7 @@ void EmulatorWrapper::handleOUT(unsigned char* opcode) {
         shift_amt = state.a & 0x7;
         break;
     case 3:
-        OutputManager::getInstance()->handleSoundUpdates(3, state.ioports.write03, state.a);
+        audioMixer->postPortWrite(total_cycles, 3, state.ioports.write03, state.a);
         state.ioports.write03 = state.a;
         break;
     case 4:
@@ -226,7 +612,7 @@ void EmulatorWrapper::handleOUT(unsigned char* opcode) {
         shift1 = state.a;
         break;
     case 5:
-        OutputManager::getInstance()->handleSoundUpdates(5, state.ioports.write05, state.a);
+        audioMixer->postPortWrite(total_cycles, 5, state.ioports.write05, state.a);
         state.ioports.write05 = state.a;
         break;
     case 6:
@@ -242,6 +628,10 @@ void EmulatorWrapper::handleIN(unsigned char* opcode) {
         break;
     case 1:
         state.a = state.ioports.read01;
+        if (state.a != traced_input && ChromeTrace::enabled()) {
+            ChromeTrace::instant("input read"); // The game has seen a key change
+        }
+        traced_input = state.a;
         break;
     case 2:
         state.a = state.ioports.read02;
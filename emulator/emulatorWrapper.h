@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include <QDebug>
+#include <QString>
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
@@ -11,13 +12,29 @@
 #include "../disassembler/disassembler.h"
 #include "../emulator/emulator.h"
 #include "../memory/mem_utils.h"
+#include "../diagnostics/instructiontrace.h"
+#include "../diagnostics/pcprofiler.h"
+#include "../diagnostics/framebudget.h"
+#include "../diagnostics/hostcounters.h"
 
 #include "ioports_t.h"
 
+class AudioMixer;
+
 class EmulatorWrapper : public QObject {
     Q_OBJECT
 
 public:
+    // Video timing. The CRT draws 262 scanlines per 60 Hz frame, 224 of them
+    // visible; the game expects RST 1 at scanline 96 and RST 2 at scanline 224.
+    static constexpr int CPU_CLOCK_HZ = 2000000;
+    static constexpr int CYCLES_PER_FRAME = CPU_CLOCK_HZ / 60;
+    static constexpr int SCANLINES_PER_FRAME = 262;
+    static constexpr int VISIBLE_SCANLINES = 224;
+    static constexpr int MID_SCREEN_SCANLINE = 96;
+    static constexpr int MID_SCREEN_CYCLE = MID_SCREEN_SCANLINE * CYCLES_PER_FRAME / SCANLINES_PER_FRAME;
+    static constexpr int END_OF_SCREEN_CYCLE = VISIBLE_SCANLINES * CYCLES_PER_FRAME / SCANLINES_PER_FRAME;
+
     // Static method to get the singleton instance
     static EmulatorWrapper& getInstance();
 
@@ -36,6 +53,35 @@ public:
     // Get video memory (read-only)
     const uint8_t* getVideoMemory() const;
 
+    // Total CPU cycles executed since power-on. Safe to call from any thread;
+    // frame = cycles / CYCLES_PER_FRAME, beam position follows from the remainder.
+    uint64_t getCycleCount() const;
+
+    // True while emulation is held by pauseEmulation().
+    bool isPaused() const { return paused; }
+
+    // Run flat out, with no pacing, until the cycle count reaches cycle.
+    // For offline rendering on the calling thread; not while startEmulation() runs.
+    void runUntil(uint64_t cycle);
+
+    // Log the memory writes the game attempted outside RAM since the last report.
+    // Called once per emulated second and by cleanup(); emulation thread only, or while it is stopped.
+    void reportViolations();
+
+    // Binary instruction trace ("instruction_trace", "trace_file", "trace_records").
+    // Toggling is safe from any thread; see tools/tracedecode for reading the file.
+    bool setTracing(bool enable);
+    bool isTracing() const { return trace.enabled(); }
+
+    // Per-PC and call-chain profile of the game ("profiler", "profile_file",
+    // "profile_stacks_file"). Safe from any thread; takes effect at the next
+    // frame, and stopping or cleanup() writes the report and the folded stacks.
+    void setProfiling(bool enable);
+    bool isProfiling() const { return profile_wanted.load(std::memory_order_relaxed); }
+
+    // How the last second of frames split into interrupt, main-loop and idle cycles. Safe from any thread.
+    FrameBudget::Summary getFrameBudget() const { return frame_budget.summary(); }
+
 public slots:
     void startEmulation();
     void runCycle();
@@ -52,7 +98,8 @@ private:
     static EmulatorWrapper* instance;
 
     // Emulator state and helper functions
-    bool running;
+    std::atomic<bool> running;
+    bool emulating; // startEmulation()'s loop is active; guarded by pauseMutex
     void dummyIOportReader();
 
     // CPU Memory and State
@@ -60,16 +107,68 @@ private:
     state_8080cpu state;
 
     // Interrupt and timing handling
-    std::chrono::high_resolution_clock::time_point previous_interrupt_time;
     std::chrono::high_resolution_clock::time_point previous_cycle_time;
     uint8_t cycles_used;
-    uint8_t interrupt_toggle;
+    uint32_t frame_cycle;       // Cycles since the start of the current frame
+    uint8_t next_interrupt;     // 1 = waiting for mid-screen, 2 = waiting for end of screen
+    uint8_t pending_interrupt;  // Raised by the beam, delivered once interrupts are enabled
+    uint64_t total_cycles;
+    std::atomic<uint64_t> cycle_count; // Published copy of total_cycles for other threads
+
+    // Rejected memory writes are counted in state.violations and summarised here
+    static constexpr int VIOLATION_REPORT_FRAMES = 60;
+    int frames_since_report;
+    memory_violations reported_violations; // Totals at the last report
+
+    InstructionTrace trace;
+    FrameBudget frame_budget;
+    HostCounters host_counters;    // "host_counters": Linux hardware counters per frame
+    uint64_t instructions_executed;
+    int64_t frame_trace_start; // Host time the current emulated frame began, for --chrome-trace
+    uint8_t traced_input;      // Port 1 as last read by the game, to mark input changes
+
+    PcProfiler profiler;
+    bool profiling;                   // Counting; emulation thread only
+    std::atomic<bool> profile_wanted; // Requested state, applied once per frame
+    QString profile_file;
+    QString profile_stacks_file;
+    void applyProfiling();
+    void writeProfile();
+
+    // Advance the emulated beam and raise the scanline interrupts
+    void advanceBeam(int cycles);
+
+    // Execute the instruction at PC, including port I/O and beam timing
+    void executeInstruction();
+
+    // Deliver a raised scanline interrupt once the CPU has interrupts enabled
+    void serviceInterrupt();
+
+    // Audio-clock pacing ("emulation_clock": "audio"): run on cycles granted by the audio output
+    static constexpr int AUDIO_WAIT_US = 500;       // Sleep between checks for new credit
+    static constexpr int AUDIO_TIMEOUT_US = 250000; // Give up on a silent output after this long
+    bool audio_paced;
+    int64_t cycle_budget;
+    int audio_wait_us;
+    bool waitForAudioCredit();
+
+    // Warm start ("warm_start": true): resume from a machine image taken once
+    // the power-on wait is over, instead of emulating it on every launch
+    static constexpr int WARM_START_FRAMES = 180; // Attract mode starts drawing 3 s after power-on
+    bool warm_start;
+    QString warm_start_file;
+    void warmStart();
+    bool loadSnapshot(const QString& path);
+    bool saveSnapshot(const QString& path) const;
 
     // Used to emulate specialized bitshifting hardware
     uint8_t shift0;
     uint8_t shift1;
     uint8_t shift_amt;
 
+    // Receives sound port writes; cached so OUT never takes a lock
+    AudioMixer* audioMixer;
+
     // Handle IN and OUT opcodes
     void handleOUT(unsigned char* opcode);
     void handleIN(unsigned char* opcode);
@@ -1,11 +1,139 @@
 #include "./ui/mainwindow.h"
+#include "./outputmanager/pixelscaler.h"
+#include "./outputmanager/afterglow.h"
+#include "./outputmanager/soundsynth.h"
+#include "./outputmanager/audiomixer.h"
+#include "./emulator/emulatorWrapper.h"
+#include "./emulator/io_bits.h"
+#include "./diagnostics/startuptimeline.h"
+#include "./diagnostics/chrometrace.h"
+#include "./diagnostics/threadcpu.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
 #include <QLocale>
+#include <QTimer>
 #include <QTranslator>
+#include <vector>
+
+// Times every upscaling filter and the afterglow pass and prints the per-frame cost.
+static int runVideoBenchmark()
+{
+    qInfo("Video filter benchmark (%s kernels)", PixelScaler::backendName());
+    for (const PixelScaler::BenchmarkResult &result : PixelScaler::benchmark()) {
+        qInfo("  %-8s %8.1f us/frame", PixelScaler::filterName(result.filter), result.microsecondsPerFrame);
+    }
+    qInfo("  %-8s %8.1f us/frame (budget %.0f us)", "afterglow", Afterglow::benchmark(), Afterglow::BUDGET_MICROSECONDS);
+    return 0;
+}
+
+// Measures the cost of the sound circuit synthesis at the output rate.
+static int runAudioBenchmark()
+{
+    qInfo("Sound synthesis benchmark");
+    qInfo("  %-8s %8.2f %% of one core at 48 kHz (budget 2 %%)", "circuits", SoundSynth::benchmark());
+    return 0;
+}
+
+// Plays a short scripted game with no window or audio device, as fast as the
+// CPU allows, and writes what the mixer renders to a WAV file.
+static int runAudioRender(const QString &path, int seconds)
+{
+    constexpr int PERIODS_PER_SECOND = MixerCore::SAMPLE_RATE / MixerCore::PERIOD_FRAMES;
+    constexpr int PERIODS_PER_TENTH = PERIODS_PER_SECOND / 10;
+    constexpr uint64_t CYCLES_PER_PERIOD = EmulatorWrapper::CPU_CLOCK_HZ / PERIODS_PER_SECOND;
+
+    EmulatorWrapper &emulator = EmulatorWrapper::getInstance();
+    AudioMixer *audioMixer = AudioMixer::getInstance();
+    audioMixer->prepareOffline();
+    if (!audioMixer->startRecording(path)) {
+        return 1;
+    }
+
+    ioports_t *ports = emulator.getIOptr();
+    const uint8_t idle = ports->read01;
+    std::vector<int16_t> block(MixerCore::PERIOD_FRAMES);
+
+    // A warm start resumes three seconds after power-on, so the script's
+    // timeline starts wherever the emulator already is
+    const uint64_t start = emulator.getCycleCount();
+
+    QElapsedTimer timer;
+    timer.start();
+    const int periods = seconds * PERIODS_PER_SECOND;
+    for (int period = 0; period < periods; ++period) {
+        // Insert a coin, start a one-player game and keep firing, so every effect gets played
+        const int tenth = period / PERIODS_PER_TENTH;
+        uint8_t input = idle;
+        if (tenth == 10) {
+            input |= CREDIT;
+        } else if (tenth == 20) {
+            input |= P1START;
+        } else if (tenth > 30 && tenth % 5 == 0) {
+            input |= P1SHOT;
+        }
+        ports->read01 = input;
+
+        emulator.runUntil(start + (period + 1) * CYCLES_PER_PERIOD);
+        audioMixer->renderOffline(block.data(), MixerCore::PERIOD_FRAMES);
+    }
+    audioMixer->stopRecording();
+
+    const double elapsed = timer.nsecsElapsed() / 1e9;
+    qInfo("Rendered %d s of audio to %s in %.2f s (%.0fx real time)",
+          seconds, qPrintable(path), elapsed, elapsed > 0.0 ? seconds / elapsed : 0.0);
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    StartupTimeline::start();
     QApplication a(argc, argv);
+    StartupTimeline::mark("application created");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption benchmarkVideoOption("benchmark-video", "Benchmark the video filters and exit.");
+    parser.addOption(benchmarkVideoOption);
+    QCommandLineOption benchmarkAudioOption("benchmark-audio", "Benchmark the sound synthesis and exit.");
+    parser.addOption(benchmarkAudioOption);
+    QCommandLineOption recordAudioOption("record-audio", "Record the sound output of the session to a WAV file.", "file");
+    parser.addOption(recordAudioOption);
+    QCommandLineOption renderAudioOption("render-audio", "Render a scripted game's sound to a WAV file without a window and exit.", "file");
+    parser.addOption(renderAudioOption);
+    QCommandLineOption renderSecondsOption("render-seconds", "Length of the --render-audio game in seconds (default 60).", "seconds", "60");
+    parser.addOption(renderSecondsOption);
+    QCommandLineOption audioBackendOption("audio-backend", "Sound output: qt (default), null or file.", "backend");
+    parser.addOption(audioBackendOption);
+    QCommandLineOption audioFileOption("audio-file", "Output file of the file audio backend.", "file");
+    parser.addOption(audioFileOption);
+    QCommandLineOption chromeTraceOption("chrome-trace", "Record a timeline of all threads to a Chrome trace-event JSON file.", "file");
+    parser.addOption(chromeTraceOption);
+    parser.process(a);
+
+    if (parser.isSet(benchmarkVideoOption)) {
+        return runVideoBenchmark();
+    }
+    if (parser.isSet(benchmarkAudioOption)) {
+        return runAudioBenchmark();
+    }
+    if (parser.isSet(renderAudioOption)) {
+        return runAudioRender(parser.value(renderAudioOption), qMax(1, parser.value(renderSecondsOption).toInt()));
+    }
+    if (parser.isSet(audioBackendOption) || parser.isSet(audioFileOption)) {
+        const AudioBackend::Kind kind = parser.isSet(audioBackendOption)
+            ? AudioBackend::kindFromName(parser.value(audioBackendOption))
+            : AudioBackend::Kind::File;
+        AudioMixer::getInstance()->setBackend(kind, parser.value(audioFileOption));
+    }
+    if (parser.isSet(recordAudioOption)) {
+        AudioMixer::getInstance()->startRecording(parser.value(recordAudioOption));
+    }
+    ChromeTrace::setThreadName("GUI");
+    ThreadCpu::registerCurrentThread("GUI");
+    if (parser.isSet(chromeTraceOption)) {
+        ChromeTrace::setEnabled(true);
+    }
 
     QTranslator translator;
     const QStringList uiLanguages = QLocale::system().uiLanguages();
@@ -18,6 +146,14 @@ int main(int argc, char *argv[])
     }
     QThread::currentThread()->setPriority(QThread::HighPriority);
     MainWindow w;
+    StartupTimeline::mark("main window constructed");
     w.show();
-    return a.exec();
+
+    // Runs once the event loop has handled the first expose and paint
+    QTimer::singleShot(0, []() { StartupTimeline::mark("first frame (main menu) presented"); });
+    const int result = a.exec();
+    if (parser.isSet(chromeTraceOption)) {
+        ChromeTrace::write(parser.value(chromeTraceOption));
+    }
+    return result;
 }
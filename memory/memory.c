@@ -1,23 +1,22 @@
 #include "memory.h"
-#include <stdio.h>
 #include <string.h>
-#include "../inputmanager/debugwrapper.h"
+#include "../diagnostics/asynclog.h"
 
 mem_block_t *create_mem_block(int size) {
     if (size <= 0) {
-        qdebug_log("Invalid memory size requested: %d\n", size);
+        ALOG_ERROR("Invalid memory size requested: %d", size);
         return NULL;
     }
 
     mem_block_t *mem = malloc(sizeof(mem_block_t));
     if (!mem) {
-        qdebug_log("Failed to allocate memory for mem_block_t\n");
+        ALOG_ERROR("Failed to allocate memory for mem_block_t");
         return NULL;
     }
 
     mem->mem = malloc(sizeof(uint8_t) * size);
     if (!mem->mem) {
-        qdebug_log("Failed to allocate memory block of size: %d\n", size);
+        ALOG_ERROR("Failed to allocate memory block of size: %d", size);
         free(mem);  // Free the structure if memory allocation fails
         return NULL;
     }
@@ -26,38 +25,21 @@ mem_block_t *create_mem_block(int size) {
     return mem;
 }
 
-int load_rom(mem_block_t *mem, const char *file_name) {
+int load_rom(mem_block_t *mem, const uint8_t *image, size_t size) {
     if (!mem || !mem->mem || mem->size <= 0) {
-        qdebug_log("Invalid memory block passed to load_rom\n");
+        ALOG_ERROR("Invalid memory block passed to load_rom");
         return -1;
     }
 
-    // Open the ROM file
-    FILE *f = fopen(file_name, "rb");
-    if (!f) {
-        qdebug_log("Could not open ROM file: %s\n", file_name);
-        return -1;
-    }
-
-    // Get the size of the ROM file
-    fseek(f, 0, SEEK_END);
-    size_t fsize = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
     // Ensure the ROM fits in the memory block
-    if (fsize > mem->size) {
-        qdebug_log("ROM size (%zu bytes) exceeds available memory size (%d bytes)\n", fsize, mem->size);
-        fclose(f);
+    if (size > (size_t)mem->size) {
+        ALOG_ERROR("ROM size (%zu bytes) exceeds available memory size (%d bytes)", size, mem->size);
         return -1;
     }
 
-    // Read the ROM data into memory
-    fread(mem->mem, 1, fsize, f);
-
-    // Close the ROM file
-    fclose(f);
+    memcpy(mem->mem, image, size);
 
-    qdebug_log("ROM loaded successfully: %s\n", file_name);
+    ALOG_INFO("ROM loaded successfully: %zu bytes", size);
     return 0;
 }
 
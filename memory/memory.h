@@ -16,7 +16,7 @@ typedef struct {
 
 // Function declarations
 mem_block_t *create_mem_block(int size); // Allocate a memory block
-int load_rom(mem_block_t *mem, const char *file_name); // Load ROM file into memory block
+int load_rom(mem_block_t *mem, const uint8_t *image, size_t size); // Copy ROM image into memory block
 void delete_mem_block(mem_block_t *block); // Free memory block
 
 #ifdef __cplusplus
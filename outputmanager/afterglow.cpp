@@ -0,0 +1,112 @@
+#include "afterglow.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AFTERGLOW_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Intensity is kept with three extra bits of precision over the palette level.
+constexpr int INTENSITY_SHIFT = 8 - VideoConverter::LEVEL_BITS;
+
+inline uint8_t blendPixel(uint8_t index, uint8_t& glow, uint8_t decay, uint8_t band) {
+    const uint8_t target = static_cast<uint8_t>((index & VideoConverter::LEVEL_MASK) << INTENSITY_SHIFT);
+    const uint8_t decayed = static_cast<uint8_t>((glow * decay) >> 8);
+    glow = std::max(target, decayed);
+    const uint8_t level = glow >> INTENSITY_SHIFT;
+    return level ? static_cast<uint8_t>(band | level) : VideoConverter::PIXEL_OFF;
+}
+
+void blendRow(uint8_t* pixels, uint8_t* glow, int x0, int x1, uint8_t decay, uint8_t band) {
+    int x = x0;
+#ifdef AFTERGLOW_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i levelMask = _mm_set1_epi8(VideoConverter::LEVEL_MASK);
+    const __m128i bandBits = _mm_set1_epi8(static_cast<char>(band));
+    const __m128i decay16 = _mm_set1_epi16(decay);
+
+    for (; x + 16 <= x1; x += 16) {
+        const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x));
+        const __m128i stored = _mm_loadu_si128(reinterpret_cast<const __m128i*>(glow + x));
+
+        // The level is at most 31, so shifting whole 16-bit lanes cannot carry between bytes.
+        const __m128i target = _mm_slli_epi16(_mm_and_si128(index, levelMask), INTENSITY_SHIFT);
+
+        const __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(stored, zero), decay16), 8);
+        const __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(stored, zero), decay16), 8);
+        const __m128i blended = _mm_max_epu8(target, _mm_packus_epi16(lo, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(glow + x), blended);
+
+        const __m128i level = _mm_and_si128(_mm_srli_epi16(blended, INTENSITY_SHIFT), levelMask);
+        const __m128i unlit = _mm_cmpeq_epi8(level, zero);
+        const __m128i out = _mm_andnot_si128(unlit, _mm_or_si128(level, bandBits));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + x), out);
+    }
+#endif
+    for (; x < x1; ++x) {
+        pixels[x] = blendPixel(pixels[x], glow[x], decay, band);
+    }
+}
+
+} // namespace
+
+Afterglow::Afterglow()
+    : intensity(VideoConverter::SCREEN_WIDTH * VideoConverter::SCREEN_HEIGHT, 0),
+    decay(0),
+    lastDuration(0.0)
+{
+    setHalfLife(25.0);
+}
+
+void Afterglow::setHalfLife(double halfLifeMs, double frameMs) {
+    if (halfLifeMs <= 0.0) {
+        decay = 0;
+        return;
+    }
+    const double factor = std::pow(0.5, frameMs / halfLifeMs);
+    decay = static_cast<uint8_t>(std::clamp(std::lround(factor * 256.0), 0L, 255L));
+}
+
+void Afterglow::apply(VideoFrame& frame, const VideoConverter::RowPalette& palette, int firstColumn, int lastColumn) {
+    const auto start = std::chrono::steady_clock::now();
+
+    firstColumn = std::max(firstColumn, 0);
+    lastColumn = std::min(lastColumn, VideoConverter::SCREEN_WIDTH);
+    for (int y = 0; y < VideoConverter::SCREEN_HEIGHT; ++y) {
+        const uint8_t band = palette.litIndex(y) & VideoConverter::BAND_MASK;
+        uint8_t* glow = intensity.data() + y * VideoConverter::SCREEN_WIDTH;
+        blendRow(frame.row(y), glow, firstColumn, lastColumn, decay, band);
+    }
+
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    lastDuration = elapsed.count();
+}
+
+void Afterglow::reset() {
+    std::fill(intensity.begin(), intensity.end(), 0);
+}
+
+double Afterglow::benchmark(int frames) {
+    std::vector<uint8_t> vram(VideoConverter::SCREEN_WIDTH * VideoConverter::BYTES_PER_SCANLINE);
+    VideoConverter::RowPalette palette;
+    VideoFrame frame(VideoConverter::SCREEN_WIDTH, VideoConverter::SCREEN_HEIGHT);
+    Afterglow afterglow;
+
+    uint32_t seed = 0x2400;
+    double total = 0.0;
+    for (int i = 0; i < frames; ++i) {
+        // Fresh content every frame so both the rise and the decay paths run.
+        for (uint8_t& byte : vram) {
+            seed = seed * 1664525u + 1013904223u;
+            byte = (seed >> 24) & (seed >> 16);
+        }
+        VideoConverter::convert(vram.data(), palette, frame);
+        afterglow.apply(frame, palette, 0, VideoConverter::SCREEN_WIDTH);
+        total += afterglow.lastMicroseconds();
+    }
+    return total / frames;
+}
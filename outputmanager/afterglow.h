@@ -0,0 +1,55 @@
+#ifndef AFTERGLOW_H
+#define AFTERGLOW_H
+
+#include <cstdint>
+#include <vector>
+#include "videoconverter.h"
+
+/**
+ * @brief Simulates phosphor persistence on the converted frame.
+ *
+ * Keeps an 8-bit intensity per screen pixel. Each frame the stored
+ * intensity decays exponentially and is raised again by any lit pixel,
+ * then written back into the frame as a palette index of the row's band.
+ * Runs after conversion and before scaling.
+ */
+class Afterglow {
+public:
+    static constexpr double BUDGET_MICROSECONDS = 500.0; ///< Per-frame time budget.
+
+    Afterglow();
+
+    /**
+     * @brief Sets how quickly the glow fades.
+     * @param halfLifeMs Time for an unlit pixel to fall to half brightness.
+     * @param frameMs Time between frames.
+     */
+    void setHalfLife(double halfLifeMs, double frameMs = 1000.0 / 60.0);
+
+    /**
+     * @brief Blends columns [firstColumn, lastColumn) of a freshly converted frame.
+     */
+    void apply(VideoFrame& frame, const VideoConverter::RowPalette& palette, int firstColumn, int lastColumn);
+
+    /**
+     * @brief Drops all stored intensity, e.g. after the display was paused.
+     */
+    void reset();
+
+    /**
+     * @brief Time taken by the most recent apply() call, in microseconds.
+     */
+    double lastMicroseconds() const { return lastDuration; }
+
+    /**
+     * @brief Average cost of a full-screen apply() over a number of frames, in microseconds.
+     */
+    static double benchmark(int frames = 600);
+
+private:
+    std::vector<uint8_t> intensity; ///< Row-major, one byte per screen pixel.
+    uint8_t decay;                  ///< Per-frame multiplier in 1/256ths.
+    double lastDuration;
+};
+
+#endif // AFTERGLOW_H
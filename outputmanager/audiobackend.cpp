@@ -0,0 +1,245 @@
+#include "audiobackend.h"
+#include "wavrecorder.h"
+#include "../diagnostics/chrometrace.h"
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QMediaDevices>
+#include <QTimer>
+#include <vector>
+
+namespace {
+
+QAudioFormat outputFormat() {
+    QAudioFormat format;
+    format.setSampleRate(MixerCore::SAMPLE_RATE);
+    format.setChannelCount(1);
+    format.setSampleFormat(QAudioFormat::Int16);
+    return format;
+}
+
+/**
+ * @brief Sequential device the sink pulls mixed audio from.
+ *
+ * readData() runs on the audio thread whenever the sink has room, so this
+ * is the audio callback: it only renders into the buffer it is given.
+ */
+class MixerDevice : public QIODevice
+{
+public:
+    MixerDevice(AudioBackend& backend, QObject* parent)
+        : QIODevice(parent), backend(backend), sink(nullptr) {}
+
+    void setSink(QAudioSink* audioSink) { sink = audioSink; }
+
+    bool isSequential() const override { return true; }
+
+    qint64 bytesAvailable() const override {
+        return MixerCore::PERIOD_FRAMES * qint64(sizeof(int16_t)) + QIODevice::bytesAvailable();
+    }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override {
+        const int frames = static_cast<int>(maxSize / qint64(sizeof(int16_t)));
+        if (frames <= 0) {
+            return 0;
+        }
+
+        // Whatever the sink still holds plays before this block
+        const qint64 queuedBytes = sink ? qMax<qint64>(sink->bufferSize() - sink->bytesFree(), 0) : 0;
+        const int64_t queuedNs = queuedBytes / qint64(sizeof(int16_t)) * 1000000000LL / MixerCore::SAMPLE_RATE;
+        backend.render(reinterpret_cast<int16_t*>(data), frames, queuedNs);
+        return frames * qint64(sizeof(int16_t));
+    }
+
+    qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+    AudioBackend& backend;
+    QAudioSink* sink;
+};
+
+// Pull-mode QAudioSink on the default output device
+class QtAudioBackend : public AudioBackend
+{
+public:
+    QtAudioBackend(MixerCore& mixer, QObject* parent)
+        : AudioBackend(mixer, parent), sink(nullptr), device(nullptr) {}
+
+    Kind kind() const override { return Kind::Qt; }
+
+    bool start() override {
+        const QAudioDevice audioDevice = QMediaDevices::defaultAudioOutput();
+        if (audioDevice.isNull()) {
+            qWarning() << "No audio output device found.";
+            return false;
+        }
+        const QAudioFormat format = outputFormat();
+        if (!audioDevice.isFormatSupported(format)) {
+            qWarning() << "Audio device does not support 48 kHz 16-bit mono; output may be resampled by the backend.";
+        }
+
+        // Two 10 ms periods: one playing, one being filled
+        device = new MixerDevice(*this, this);
+        device->open(QIODevice::ReadOnly);
+        sink = new QAudioSink(audioDevice, format, this);
+        sink->setBufferSize(2 * MixerCore::PERIOD_FRAMES * qsizetype(sizeof(int16_t)));
+        device->setSink(sink);
+        sink->start(device);
+        if (sink->error() != QAudio::NoError) {
+            qWarning() << "Audio output failed to start, error" << sink->error();
+            stop();
+            return false;
+        }
+
+        qDebug() << "Audio output started on" << audioDevice.description() << "buffer" << sink->bufferSize() << "bytes";
+        return true;
+    }
+
+    void stop() override {
+        if (sink) {
+            sink->stop();
+            sink = nullptr;
+        }
+        if (device) {
+            device->close();
+            device = nullptr;
+        }
+    }
+
+private:
+    QAudioSink* sink;
+    MixerDevice* device;
+};
+
+// Nothing is rendered; AudioMixer stops queuing sound events for it
+class NullAudioBackend : public AudioBackend
+{
+public:
+    NullAudioBackend(MixerCore& mixer, QObject* parent) : AudioBackend(mixer, parent) {}
+
+    Kind kind() const override { return Kind::Null; }
+    bool start() override { return true; }
+    void stop() override {}
+};
+
+// Renders on a timer at the real-time rate and writes the blocks to a WAV file
+class FileAudioBackend : public AudioBackend
+{
+public:
+    FileAudioBackend(MixerCore& mixer, const QString& filePath, QObject* parent)
+        : AudioBackend(mixer, parent), path(filePath), timer(nullptr), renderedFrames(0),
+        block(MixerCore::PERIOD_FRAMES) {}
+
+    ~FileAudioBackend() override { stop(); }
+
+    Kind kind() const override { return Kind::File; }
+
+    bool start() override {
+        if (!recorder.start(path.toStdString(), MixerCore::SAMPLE_RATE)) {
+            qWarning() << "Could not create audio output file" << path;
+            return false;
+        }
+        renderedFrames = 0;
+        clock.start();
+        timer = new QTimer(this);
+        timer->setTimerType(Qt::PreciseTimer);
+        timer->setInterval(MixerCore::PERIOD_FRAMES * 1000 / MixerCore::SAMPLE_RATE);
+        connect(timer, &QTimer::timeout, this, [this]() { renderDue(); });
+        timer->start();
+        qDebug() << "Audio output goes to" << path;
+        return true;
+    }
+
+    void stop() override {
+        if (timer) {
+            timer->stop();
+            timer = nullptr;
+        }
+        recorder.stop();
+    }
+
+private:
+    QString path;
+    WavRecorder recorder;
+    QTimer* timer;
+    QElapsedTimer clock;
+    uint64_t renderedFrames;
+    std::vector<int16_t> block;
+
+    // Catch up with the wall clock in whole periods, like a sound card would pull them
+    void renderDue() {
+        const uint64_t due = static_cast<uint64_t>(clock.nsecsElapsed()) * MixerCore::SAMPLE_RATE / 1000000000ULL;
+        while (renderedFrames + MixerCore::PERIOD_FRAMES <= due) {
+            render(block.data(), MixerCore::PERIOD_FRAMES, 0);
+            recorder.write(block.data(), block.size());
+            renderedFrames += MixerCore::PERIOD_FRAMES;
+        }
+    }
+};
+
+} // namespace
+
+AudioBackend::AudioBackend(MixerCore& mixer, QObject* parent)
+    : QObject(parent), mixer(mixer), framesSinceReport(0)
+{
+}
+
+const char* AudioBackend::kindName(Kind kind) {
+    switch (kind) {
+    case Kind::Qt: return "qt";
+    case Kind::Null: return "null";
+    case Kind::File: return "file";
+    }
+    return "";
+}
+
+AudioBackend::Kind AudioBackend::kindFromName(const QString& name, Kind fallback) {
+    for (Kind kind : { Kind::Qt, Kind::Null, Kind::File }) {
+        if (name.compare(kindName(kind), Qt::CaseInsensitive) == 0) {
+            return kind;
+        }
+    }
+    return fallback;
+}
+
+AudioBackend* AudioBackend::create(Kind kind, MixerCore& mixer, const QString& filePath, QObject* parent) {
+    switch (kind) {
+    case Kind::Null: return new NullAudioBackend(mixer, parent);
+    case Kind::File: return new FileAudioBackend(mixer, filePath, parent);
+    case Kind::Qt: break;
+    }
+    return new QtAudioBackend(mixer, parent);
+}
+
+void AudioBackend::render(int16_t* out, int frames, int64_t outputDelayNs) {
+    CHROME_TRACE_SCOPE("audio render");
+    mixer.render(out, frames, outputDelayNs);
+
+    // Report roughly every ten seconds of audio
+    framesSinceReport += frames;
+    if (framesSinceReport < MixerCore::SAMPLE_RATE * 10) {
+        return;
+    }
+    framesSinceReport = 0;
+    const MixerCore::LatencyStats stats = mixer.takeLatencyStats();
+    if (stats.triggers > 0) {
+        qDebug("Sound trigger-to-output latency: avg %.2f ms, worst %.2f ms over %llu triggers "
+               "(%llu late, %llu re-anchors)",
+               stats.averageMicroseconds / 1000.0, stats.worstMicroseconds / 1000.0,
+               static_cast<unsigned long long>(stats.triggers),
+               static_cast<unsigned long long>(stats.lateEvents),
+               static_cast<unsigned long long>(stats.reanchors));
+    }
+    if (mixer.isPacing()) {
+        const MixerCore::PacingStats pacing = mixer.pacingStats();
+        qDebug("Audio-clock pacing: rate %.4f, emulator lead %.2f ms", pacing.rate, pacing.leadMs);
+    }
+    if (const uint64_t dropped = mixer.takeDroppedEvents()) {
+        qWarning("Sound event queue overflowed, %llu port writes dropped",
+                 static_cast<unsigned long long>(dropped));
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef AUDIOBACKEND_H
+#define AUDIOBACKEND_H
+
+#include <QObject>
+#include <QString>
+#include "mixercore.h"
+
+/**
+ * @brief Destination of the mixed output.
+ *
+ * The mixer does not care who pulls its blocks: a backend owns the clock
+ * that calls render(). Backends are created and started on the audio thread.
+ * Besides the sound card there is a null backend for batch and benchmark
+ * runs, and a file backend for machines without a sound card.
+ */
+class AudioBackend : public QObject
+{
+public:
+    enum class Kind {
+        Qt,   ///< The default output device through QAudioSink.
+        Null, ///< No output at all; sound events are discarded before they are queued.
+        File  ///< Rendered in real time into a WAV file.
+    };
+
+    static const char* kindName(Kind kind);
+    static Kind kindFromName(const QString& name, Kind fallback = Kind::Qt);
+
+    /**
+     * @brief Creates a backend of the given kind.
+     * @param filePath Output file, used by Kind::File only.
+     */
+    static AudioBackend* create(Kind kind, MixerCore& mixer, const QString& filePath, QObject* parent);
+
+    virtual Kind kind() const = 0;
+
+    /**
+     * @brief Starts pulling blocks from the mixer.
+     * @return False if the output could not be opened.
+     */
+    virtual bool start() = 0;
+
+    /**
+     * @brief Stops pulling blocks; safe to call when not started.
+     */
+    virtual void stop() = 0;
+
+    /**
+     * @brief Mixes the next block and logs the mixer statistics every ten seconds of audio.
+     */
+    void render(int16_t* out, int frames, int64_t outputDelayNs);
+
+protected:
+    AudioBackend(MixerCore& mixer, QObject* parent);
+
+    MixerCore& mixer;
+
+private:
+    int framesSinceReport;
+};
+
+#endif // AUDIOBACKEND_H
@@ -1,58 +1,65 @@
 #include "audiomixer.h"
+#include "wavfile.h"
+#include "../diagnostics/startuptimeline.h"
 #include <QDebug>
-#include <QMediaDevices>
-#include <QSoundEffect>
+#include <QAudioBuffer>
+#include <QAudioFormat>
 #include <QFile>
 #include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QUrl>
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <thread>
 
 // Initialize static member
 AudioMixer* AudioMixer::instance = nullptr;
 
 AudioMixer::AudioMixer(QObject *parent)
     : QObject(parent),
-    menuMusic(nullptr)
+    backend(nullptr),
+    backendKind(AudioBackend::Kind::Qt),
+    backendFile(QDir::currentPath() + "/audio_output.wav"),
+    acceptingEvents(true),
+    voicesLoaded(false),
+    voiceLoader(nullptr),
+    musicDecoder(nullptr),
+    musicPosition(0),
+    musicDecoded(false),
+    musicRequested(false),
+    musicFeeder(nullptr)
 {
-    audioDevice = QMediaDevices::defaultAudioOutput();
-    audioOutput = new QAudioOutput(this);
-    audioEngine = new QAudioEngine();
-
-    configureAudioEngine();
-    qDebug() << "AudioMixer initialized.";
+    startupTimer.start();
+    loadSettings();
+    qDebug() << "AudioMixer initialized in" << startupTimer.elapsed() << "ms.";
 }
 
 AudioMixer::~AudioMixer() {
     qDebug() << "AudioMixer destructor called.";
+    stopRecording();
 
-    // Stop and delete the menu music
-    if (menuMusic) {
-        menuMusic->stop();
-        QObject::disconnect(menuMusic, nullptr, nullptr, nullptr);
-        menuMusic->setSource(QUrl());
-        menuMusic = nullptr;
-        qDebug() << "Menu music stopped and deleted.";
+    // The workers write into voiceLoads
+    if (voiceLoader) {
+        voiceLoader->waitForFinished();
     }
 
-    // Stop and delete all sound effects in the soundBoard
-    for (auto it = soundBoard.begin(); it != soundBoard.end(); ++it) {
-        QSoundEffect* soundEffect = it.value();
-        if (soundEffect) {
-            soundEffect->stop();
-        }
+    // Stop the menu music
+    if (musicFeeder) {
+        musicFeeder->stop();
+        musicFeeder = nullptr;
     }
-    soundBoard.clear();
-    qDebug() << "SoundBoard cleared and all sound effects deleted.";
-
-    // Delete the audio engine
-    if (audioEngine) {
-        audioEngine->stop();
-        audioEngine = nullptr;
-        qDebug() << "Audio engine stopped and deleted.";
+    if (musicDecoder) {
+        musicDecoder->stop();
+        musicDecoder = nullptr;
+        qDebug() << "Menu music stopped and deleted.";
     }
 
-    // Delete the audio output
-    if (audioOutput) {
-        audioOutput = nullptr;
-        qDebug() << "Audio output deleted.";
+    // Stop the output
+    if (backend) {
+        backend->stop();
+        backend = nullptr;
+        qDebug() << "Audio output stopped.";
     }
 
     qDebug() << "AudioMixer destructor completed.";
@@ -66,126 +73,241 @@ AudioMixer* AudioMixer::getInstance() {
     return instance;
 }
 
-void AudioMixer::configureAudioEngine() {
-    // Configure audio engine
-    audioEngine->setOutputDevice(audioDevice);
-    audioEngine->setOutputMode(QAudioEngine::Stereo);
-    audioEngine->setMasterVolume(1.0);
-    audioEngine->start();
-
-    // Configure menu music
-    menuMusic = new QAmbientSound(audioEngine);
-    menuMusic->setSource(QUrl("qrc:/sounds/sounds/MenuTrack.mp3"));
-    menuMusic->setLoops(QAmbientSound::Infinite);
-    menuMusic->setVolume(0.5f);
+void AudioMixer::loadSettings() {
+    QFile settingsFile(QDir::currentPath() + "/.settings.json");
+    if (settingsFile.open(QIODevice::ReadOnly)) {
+        QJsonObject jsonObject = QJsonDocument::fromJson(settingsFile.readAll()).object();
+        const QString modeName = jsonObject["sound_mode"].toString("samples");
+        mixer.setMode(MixerCore::modeFromName(modeName.toStdString()));
+        setBackend(AudioBackend::kindFromName(jsonObject["audio_backend"].toString("qt")),
+                   jsonObject["audio_file"].toString());
+    }
+    qDebug() << "Sound mode:" << MixerCore::modeName(mixer.soundMode());
+}
 
-    // Prepare sound board of all playable sounds
-    constructSoundBoard();
+void AudioMixer::setBackend(AudioBackend::Kind kind, const QString& filePath) {
+    backendKind = kind;
+    if (!filePath.isEmpty()) {
+        backendFile = filePath;
+    }
+    acceptingEvents.store(kind != AudioBackend::Kind::Null, std::memory_order_relaxed);
+    qDebug() << "Audio backend:" << AudioBackend::kindName(kind);
 }
 
-void AudioMixer::constructSoundBoard() {
-    QMap<QString, QSoundEffect *> soundBoard;
-    QString resourcePath = ":/sounds/sounds"; // Path in the Qt Resource System
-    QDir dir(resourcePath);
+void AudioMixer::loadVoices() {
+    if (voicesLoaded || mixer.soundMode() != SoundMode::Samples) {
+        return;
+    }
+    voicesLoaded = true;
 
-    // Check if the directory exists
-    if (!dir.exists()) {
-        qWarning() << "The sound resource folder does not exist:" << resourcePath;
+    voiceLoads.clear();
+    for (int v = 0; v < MixerCore::VOICE_COUNT; ++v) {
+        voiceLoads.append({ static_cast<Voice>(v), {} });
     }
 
-    // List all files in the directory
-    QStringList soundFiles = dir.entryList(QDir::Files);
-    qDebug() << soundFiles;
+    // Output and menu carry on meanwhile; an effect triggered before its
+    // sample is installed is simply silent
+    voiceTimer.start();
+    voiceLoader = new QFutureWatcher<void>(this);
+    connect(voiceLoader, &QFutureWatcher<void>::finished, this, &AudioMixer::installVoices);
+    voiceLoader->setFuture(QtConcurrent::map(voiceLoads, [](VoiceLoad& load) {
+        load.pcm = decodeVoice(load.voice);
+    }));
+}
 
-    if (soundFiles.isEmpty()) {
-        qWarning() << "No sound files found in the resource folder:" << resourcePath;
-    }
+std::vector<int16_t> AudioMixer::decodeVoice(Voice voice) {
+    const QString filePath = QString(":/sounds/sounds/") + voiceFileName(voice); // Path in the Qt Resource System
 
-    // Debug: List all found files
-    qDebug() << "Found files:" << soundFiles;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Sound effect not found:" << filePath;
+        return {};
+    }
+    const QByteArray bytes = file.readAll();
 
-    // Populate the map with only .wav files
-    for (const QString &file : soundFiles) {
-        if (file.endsWith(".wav", Qt::CaseInsensitive)) { // Only include .wav files
-            QString key = file;                          // Use the file name as the key
-            QString filePath = resourcePath + "/" + file; // Full resource path
-            QSoundEffect *sound = new QSoundEffect(); // Create QSoundEffect object
-            sound->setSource(QUrl("qrc:/sounds/sounds/" + file)); // Set source
-            sound->moveToThread(thread());
+    WavFile::Pcm pcm;
+    if (!WavFile::decode(reinterpret_cast<const uint8_t*>(bytes.constData()), size_t(bytes.size()), pcm)) {
+        qWarning() << "Unsupported WAV format:" << filePath;
+        return {};
+    }
+    std::vector<int16_t> samples = WavFile::toMono(pcm, MixerCore::SAMPLE_RATE);
+    qDebug() << "Loaded" << filePath << "->" << samples.size() << "samples";
+    return samples;
+}
 
-            if (sound) {
-                AudioMixer::soundBoard.insert(key, sound);      // Add to the map
-                qDebug() << "Added QSound for:" << key << "->" << filePath;
-            } else {
-                qDebug() << "Failed to create QSound for:" << filePath;
-            }
-        } else {
-            qDebug() << "Skipping non-.wav file:" << file;
+void AudioMixer::installVoices() {
+    if (voiceLoads.isEmpty()) {
+        return;
+    }
+    for (VoiceLoad& load : voiceLoads) {
+        if (!load.pcm.empty()) {
+            mixer.setSample(load.voice, std::move(load.pcm));
         }
     }
+    voiceLoads.clear();
+    qDebug() << "Sound effects decoded in" << voiceTimer.elapsed() << "ms on" << QThreadPool::globalInstance()->maxThreadCount() << "threads";
+    StartupTimeline::mark("sound effects ready");
+}
 
-    if (soundBoard.isEmpty()) {
-        qDebug() << "No .wav files found in the resource folder:" << resourcePath;
-    } else {
-        qDebug() << "Soundboard keys:";
-        qDebug() << AudioMixer::soundBoard.keys();
+void AudioMixer::initialize() {
+    if (backend) {
+        return;
     }
 
-}
+    // Decode all effects up front so nothing is loaded while playing
+    if (backendKind != AudioBackend::Kind::Null) {
+        loadVoices();
+    }
 
-void AudioMixer::startMenuMusic() {
-    if (menuMusic) {
-        menuMusic->stop();
-        menuMusic->play();
+    backend = AudioBackend::create(backendKind, mixer, backendFile, this);
+    if (!backend->start()) {
+        // Never hold up the emulator for want of a sound card
+        qWarning() << "Audio backend" << AudioBackend::kindName(backendKind) << "failed; continuing without sound.";
+        delete backend;
+        setBackend(AudioBackend::Kind::Null);
+        backend = AudioBackend::create(backendKind, mixer, backendFile, this);
+        backend->start();
+    }
+    StartupTimeline::mark("audio output started");
+    if (backendKind == AudioBackend::Kind::Null) {
+        return; // Nothing to hear, so skip the music as well
     }
+
+    musicFeeder = new QTimer(this);
+    musicFeeder->setInterval(MUSIC_FEED_MS);
+    connect(musicFeeder, &QTimer::timeout, this, &AudioMixer::feedMusic);
+    startMusicDecoder();
 }
 
-void AudioMixer::stopMenuMusic() {
-    if (menuMusic) {
-        menuMusic->stop();
-    }
+void AudioMixer::startMusicDecoder() {
+    QAudioFormat format;
+    format.setSampleRate(MixerCore::SAMPLE_RATE);
+    format.setChannelCount(1);
+    format.setSampleFormat(QAudioFormat::Int16);
+
+    startupTimer.restart();
+    musicDecoder = new QAudioDecoder(this);
+    musicDecoder->setAudioFormat(format);
+    musicDecoder->setSource(QUrl("qrc:/sounds/sounds/MenuTrack.mp3"));
+
+    connect(musicDecoder, &QAudioDecoder::bufferReady, this, &AudioMixer::appendMusic);
+    connect(musicDecoder, &QAudioDecoder::finished, this, [this]() {
+        musicDecoded = true;
+        qDebug() << "Menu music decoded in" << startupTimer.elapsed() << "ms," << musicPcm.size() << "samples";
+        StartupTimeline::mark("menu music decoded");
+    });
+    connect(musicDecoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error), this, [this]() {
+        qWarning() << "Menu music could not be decoded:" << musicDecoder->errorString();
+    });
+    musicDecoder->start();
 }
 
-void AudioMixer::playSoundEffect(const QString &fileName, bool loop) {
-    if (!AudioMixer::soundBoard.contains(fileName)) {
-        qWarning() << "Sound effect not found for file:" << fileName;
+void AudioMixer::appendMusic() {
+    const QAudioBuffer buffer = musicDecoder->read();
+    const QAudioFormat format = buffer.format();
+    const int channels = format.channelCount();
+    const qsizetype samples = buffer.sampleCount();
+    if (channels < 1 || samples == 0) {
         return;
     }
 
-    QSoundEffect* sound = AudioMixer::soundBoard[fileName];
-    if (!sound) {
-        qWarning() << "Null QSoundEffect for file:" << fileName;
-        return;
+    // Normally already 48 kHz mono Int16, but the decoder may ignore the requested format
+    WavFile::Pcm pcm;
+    pcm.sampleRate = format.sampleRate();
+    pcm.channels = channels;
+    pcm.samples.resize(size_t(samples));
+    for (qsizetype i = 0; i < samples; ++i) {
+        const float value = format.normalizedSampleValue(buffer.constData<char>() + i * format.bytesPerSample());
+        pcm.samples[size_t(i)] = static_cast<int16_t>(qBound(-1.0f, value * MUSIC_VOLUME, 1.0f) * 32767.0f);
     }
 
-    // Used for the UFO
-    if (loop) {
-        sound->setLoopCount(QSoundEffect::Infinite);
+    const std::vector<int16_t> mono = WavFile::toMono(pcm, MixerCore::SAMPLE_RATE);
+    musicPcm.append(QVector<int16_t>(mono.begin(), mono.end()));
+
+    // Start streaming as soon as the first buffers are in
+    if (musicRequested) {
+        feedMusic();
     }
+}
 
-    if (QThread::currentThread() != thread()) {
-        QMetaObject::invokeMethod(sound, "play", Qt::QueuedConnection);
-    } else {
-        sound->play();
+void AudioMixer::feedMusic() {
+    while (musicRequested) {
+        const size_t space = mixer.musicSpace();
+        if (space == 0) {
+            return;
+        }
+        if (musicPosition >= musicPcm.size()) {
+            if (!musicDecoded || musicPcm.isEmpty()) {
+                return; // Wait for the decoder
+            }
+            musicPosition = 0; // Loop
+        }
+        const size_t available = size_t(musicPcm.size() - musicPosition);
+        musicPosition += qsizetype(mixer.pushMusic(musicPcm.constData() + musicPosition, qMin(space, available)));
     }
+}
 
+void AudioMixer::startMenuMusic() {
+    musicPosition = 0;
+    musicRequested = true;
+    mixer.setMusicPlaying(true);
+    feedMusic();
+    if (musicFeeder) {
+        musicFeeder->start();
+    }
 }
 
-void AudioMixer::stopSoundEffect(const QString &fileName) {
-    if (!AudioMixer::soundBoard.contains(fileName)) {
-        qWarning() << "Sound effect not found for file:" << fileName;
-        return;
+void AudioMixer::stopMenuMusic() {
+    musicRequested = false;
+    mixer.setMusicPlaying(false);
+    if (musicFeeder) {
+        musicFeeder->stop();
     }
+}
+
+bool AudioMixer::startRecording(const QString& path) {
+    stopRecording();
+    if (!recorder.start(path.toStdString(), MixerCore::SAMPLE_RATE)) {
+        qWarning() << "Could not create audio recording" << path;
+        return false;
+    }
+    mixer.setRecorder(&recorder);
+    qDebug() << "Recording audio to" << path;
+    return true;
+}
 
-    QSoundEffect* sound = AudioMixer::soundBoard[fileName];
-    if (!sound) {
-        qWarning() << "Null QSoundEffect for file:" << fileName;
+void AudioMixer::stopRecording() {
+    if (!recorder.isRecording()) {
         return;
     }
+    mixer.setRecorder(nullptr);
+    recorder.stop();
+    if (recorder.droppedSamples()) {
+        qWarning() << "Audio recording dropped" << recorder.droppedSamples() << "samples; the disk could not keep up.";
+    }
+    qDebug() << "Audio recording finished.";
+}
 
-    if (QThread::currentThread() != thread()) {
-        QMetaObject::invokeMethod(sound, "stop", Qt::QueuedConnection);
-    } else {
-        sound->stop();
+void AudioMixer::prepareOffline() {
+    acceptingEvents.store(true, std::memory_order_relaxed);
+    loadVoices();
+    if (voiceLoader) {
+        voiceLoader->waitForFinished();
+        installVoices();
     }
 }
+
+void AudioMixer::renderOffline(int16_t* out, int frames) {
+    while (recorder.isRecording() && recorder.space() < size_t(frames)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    mixer.render(out, frames, 0);
+}
+
+void AudioMixer::playVoice(Voice voice, bool loop) {
+    mixer.trigger(voice, loop);
+}
+
+void AudioMixer::stopVoice(Voice voice) {
+    mixer.stop(voice);
+}
@@ -2,17 +2,36 @@
 #define AUDIOMIXER_H
 
 #include <QObject>
-#include <QAudioEngine>
-#include <QAmbientSound>
-#include <QAudioDevice>
-#include <QAudioOutput>
-#include <QMap>
+#include <QAudioDecoder>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QString>
-#include <QSoundEffect>
 #include <QThread>
+#include <QTimer>
+#include <QVector>
+#include "mixercore.h"
+#include "wavrecorder.h"
+#include "audiobackend.h"
 
 /**
  * @brief The AudioMixer class handles all audio-related functionality in the application.
+ *
+ * Sound effects are decoded to PCM at startup, in parallel and without
+ * holding up the output or the menu, and mixed by a MixerCore
+ * in 10 ms periods for an AudioBackend: the sound card by default, a WAV
+ * file, or nothing at all ("audio_backend" in .settings.json or
+ * --audio-backend). Effects are addressed by
+ * Voice, and playVoice()/stopVoice() are safe to call from any thread. The
+ * emulator reports sound port writes through postPortWrite().
+ *
+ * With "sound_mode": "synthesis" in .settings.json the sample files are not
+ * loaded at all and the effects come from the modelled sound circuits.
+ *
+ * The menu music is decoded with QAudioDecoder on the audio thread and
+ * streamed into the same output, so no second audio pipeline is needed.
+ *
+ * startRecording() captures the mixed output to a WAV file, either live or
+ * from renderOffline() when no audio device is involved.
  */
 class AudioMixer : public QObject
 {
@@ -41,43 +60,167 @@ public:
     Q_INVOKABLE void stopMenuMusic();
 
     /**
-     * @brief Plays a one-shot sound effect.
-     * @param filePath Path to the sound effect file.
+     * @brief Starts a sound effect from the beginning.
+     * @param voice The effect to play.
+     * @param loop Repeat until stopVoice() is called (used for the UFO).
      */
-    Q_INVOKABLE void playSoundEffect(const QString &filePath, bool loop = false);
+    void playVoice(Voice voice, bool loop = false);
 
     /**
-     * @brief Stops a looping effect
-     * @param filePath Path to the sound effect file.
+     * @brief Stops a (looping) sound effect.
+     * @param voice The effect to stop.
      */
-    Q_INVOKABLE void stopSoundEffect(const QString &filePath);
+    void stopVoice(Voice voice);
 
     /**
-     * @brief Initializes the audio mixer (to be called after moving to a thread).
+     * @brief Queues a write to sound port 3 or 5; emulator thread only.
+     *
+     * Lock-free and allocation-free: the record goes onto a single-producer
+     * ring that the audio thread drains before mixing each period.
      */
-    void initialize();
+    void postPortWrite(uint64_t cycle, uint8_t port, uint8_t oldValue, uint8_t newValue) {
+        if (acceptingEvents.load(std::memory_order_relaxed)) {
+            mixer.postPortWrite(cycle, port, oldValue, newValue);
+        }
+    }
+
+    /**
+     * @brief True when there is no audio output, so nothing can pace the emulator.
+     */
+    bool isSilent() const { return !acceptingEvents.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Chooses the output, overriding the settings file; call before initialize().
+     * @param filePath Output file for the file backend; empty keeps the configured one.
+     */
+    void setBackend(AudioBackend::Kind kind, const QString& filePath = QString());
+
+    /**
+     * @brief Publishes the emulator's cycle counter for latency measurement (null to detach).
+     *
+     * Detaching returns once the audio callback can no longer read the old counter.
+     */
+    void setCycleClock(const std::atomic<uint64_t>* cycles, int cyclesPerSecond) {
+        mixer.setCycleClock(cycles, cyclesPerSecond);
+    }
+
+    /**
+     * @brief Lets the effects output pace the emulator instead of the wall clock.
+     */
+    void setPacing(bool enabled) { mixer.setPacing(enabled); }
+
+    /**
+     * @brief Cycles the audio clock has granted since the previous call; emulator thread only.
+     */
+    int64_t takeCycleCredit() { return mixer.takeCycleCredit(); }
+
+    /**
+     * @brief Audio queued in the output buffer at the last callback, in milliseconds.
+     */
+    double outputQueuedMs() const { return mixer.outputQueuedMs(); }
+
+    /**
+     * @brief Loads the sounds and opens the output (to be called after moving to a thread).
+     *
+     * Falls back to the null backend if the output cannot be opened.
+     */
+    Q_INVOKABLE void initialize();
+
+    /**
+     * @brief Starts writing everything the mixer renders to a WAV file.
+     * @return False if the file could not be created.
+     */
+    bool startRecording(const QString& path);
+
+    /**
+     * @brief Finishes the recording; also done on destruction.
+     */
+    void stopRecording();
+
+    /**
+     * @brief Loads the sounds for renderOffline(), whatever the configured backend.
+     */
+    void prepareOffline();
+
+    /**
+     * @brief Renders the next block without an audio device, for offline capture.
+     *
+     * Waits for the recorder to catch up instead of dropping samples, so it
+     * must not be mixed with a running output.
+     */
+    void renderOffline(int16_t* out, int frames);
 
 private:
-    QAudioEngine* audioEngine;      ///< Audio engine for managing audio objects.
-    QAudioDevice audioDevice;      ///< Audio device for playback.
-    QAmbientSound* menuMusic;      ///< Ambient sound for looping background music.
-    QAudioOutput* audioOutput;     ///< Audio output for media playback.
+    MixerCore mixer;               ///< Decoded effects and the voice mixer.
+    AudioBackend* backend;         ///< Pulls the mixed output, created by initialize().
+    AudioBackend::Kind backendKind;
+    QString backendFile;           ///< Output of the file backend.
+    std::atomic<bool> acceptingEvents; ///< False for the null backend: port writes are not even queued.
+    bool voicesLoaded;             ///< Decoding has been started (or skipped for synthesis).
+
+    // One effect being decoded on the thread pool
+    struct VoiceLoad {
+        Voice voice;
+        std::vector<int16_t> pcm;
+    };
+    QVector<VoiceLoad> voiceLoads; ///< Filled in place by the worker threads.
+    QFutureWatcher<void>* voiceLoader;
+    QElapsedTimer voiceTimer;
+    WavRecorder recorder;          ///< Optional capture of the mixed output.
+
+    // Menu music
+    static constexpr float MUSIC_VOLUME = 0.5f;
+    static constexpr int MUSIC_FEED_MS = 20;  ///< Well inside the music ring's 170 ms
+    QAudioDecoder* musicDecoder;   ///< Decodes MenuTrack.mp3 once, in the background.
+    QVector<int16_t> musicPcm;     ///< Decoded track at the output format.
+    qsizetype musicPosition;       ///< Next sample of musicPcm to stream.
+    bool musicDecoded;             ///< The whole track is in musicPcm and can loop.
+    bool musicRequested;           ///< startMenuMusic() was called and not yet stopped.
+    QTimer* musicFeeder;           ///< Tops up the mixer's music ring.
+    QElapsedTimer startupTimer;    ///< Measures construction and decoding time.
 
     static AudioMixer* instance;   ///< Static pointer to the singleton instance.
 
-    void constructSoundBoard();
-    QMap<QString, QSoundEffect* > soundBoard;
+    /**
+     * @brief Reads the audio settings from .settings.json.
+     */
+    void loadSettings();
 
     /**
-     * @brief Private constructor for the singleton pattern.
-     * @param parent Pointer to the parent QObject, default is nullptr.
+     * @brief Starts decoding every effect sample on the thread pool, once, unless synthesising.
      */
-    explicit AudioMixer(QObject *parent = nullptr);
+    void loadVoices();
 
     /**
-     * @brief Configures the audio engine and initializes components.
+     * @brief Hands the decoded effects to the mixer; runs on the audio thread.
      */
-    void configureAudioEngine();
+    void installVoices();
+
+    /**
+     * @brief Reads and converts one effect sample. Runs on a pool thread.
+     */
+    static std::vector<int16_t> decodeVoice(Voice voice);
+
+    /**
+     * @brief Starts decoding the menu music in the background.
+     */
+    void startMusicDecoder();
+
+    /**
+     * @brief Converts a decoded buffer to the output format and appends it to the track.
+     */
+    void appendMusic();
+
+    /**
+     * @brief Streams the next stretch of the track into the mixer, looping at the end.
+     */
+    void feedMusic();
+
+    /**
+     * @brief Private constructor for the singleton pattern.
+     * @param parent Pointer to the parent QObject, default is nullptr.
+     */
+    explicit AudioMixer(QObject *parent = nullptr);
 };
 
 #endif // AUDIOMIXER_H
@@ -0,0 +1,409 @@
+#include "mixercore.h"
+#include "wavrecorder.h"
+#include "../emulator/io_bits.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIXERCORE_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Adds src into dst with 16-bit saturation.
+void mixInto(int16_t* dst, const int16_t* src, int count) {
+    int i = 0;
+#ifdef MIXERCORE_HAVE_SSE2
+    for (; i + 8 <= count; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_adds_epi16(a, b));
+    }
+#endif
+    for (; i < count; ++i) {
+        const int32_t sum = dst[i] + src[i];
+        dst[i] = static_cast<int16_t>(std::clamp(sum, -32768, 32767));
+    }
+}
+
+} // namespace
+
+const char* voiceFileName(Voice voice) {
+    switch (voice) {
+    case Voice::Ufo: return "ufo_lowpitch.wav";
+    case Voice::Shot: return "shoot.wav";
+    case Voice::PlayerDie: return "explosion.wav";
+    case Voice::InvaderDie: return "invaderkilled.wav";
+    case Voice::Fleet1: return "fastinvader1.wav";
+    case Voice::Fleet2: return "fastinvader2.wav";
+    case Voice::Fleet3: return "fastinvader3.wav";
+    case Voice::Fleet4: return "fastinvader4.wav";
+    case Voice::UfoHit: return "ufo_highpitch.wav";
+    case Voice::Count: break;
+    }
+    return "";
+}
+
+const char* MixerCore::modeName(SoundMode soundMode) {
+    return soundMode == SoundMode::Synthesis ? "synthesis" : "samples";
+}
+
+SoundMode MixerCore::modeFromName(const std::string& name, SoundMode fallback) {
+    for (SoundMode m : { SoundMode::Samples, SoundMode::Synthesis }) {
+        if (name == modeName(m)) {
+            return m;
+        }
+    }
+    return fallback;
+}
+
+MixerCore::MixerCore()
+    : mode(SoundMode::Samples),
+    synth(SAMPLE_RATE),
+    droppedEvents(0),
+    outputQueueNs(0),
+    cycleClock(nullptr),
+    rendering(false),
+    pendingDetach(false),
+    cycleClockHz(1),
+    pendingStarts(0),
+    pendingLoops(0),
+    pendingStops(0),
+    latencyCount(0),
+    latencySumNs(0.0),
+    latencyWorstNs(0.0),
+    lateEvents(0),
+    reanchors(0),
+    renderedFrames(0),
+    anchored(false),
+    anchorCycle(0),
+    anchorFrame(0),
+    musicPlaying(false),
+    recorder(nullptr),
+    pacing(false),
+    cycleCredit(0),
+    creditRemainder(0.0),
+    pacingRate(1.0),
+    pacingLeadFrames(0.0)
+{
+    for (std::atomic<int64_t>& time : triggerTimes) {
+        time.store(0, std::memory_order_relaxed);
+    }
+}
+
+void MixerCore::setSample(Voice voice, std::vector<int16_t> pcm) {
+    VoiceState& state = voices[static_cast<int>(voice)];
+    state.pcm = std::move(pcm);
+    state.position = 0;
+    state.playing = false;
+}
+
+void MixerCore::setCycleClock(const std::atomic<uint64_t>* cycles, int cyclesPerSecond) {
+    if (cycles) {
+        cycleClockHz = cyclesPerSecond;
+        cycleClock.store(cycles, std::memory_order_release);
+        return;
+    }
+
+    // Sequentially consistent on both sides: either the block in progress
+    // loaded the null pointer, or this sees its rendering flag and waits.
+    pendingDetach.store(true, std::memory_order_release);
+    cycleClock.store(nullptr);
+    while (rendering.load()) {
+        std::this_thread::yield();
+    }
+}
+
+void MixerCore::trigger(Voice voice, bool loop) {
+    const uint32_t bit = 1u << static_cast<int>(voice);
+    triggerTimes[static_cast<int>(voice)].store(nowNs(), std::memory_order_relaxed);
+    if (loop) {
+        pendingLoops.fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        pendingLoops.fetch_and(~bit, std::memory_order_relaxed);
+    }
+    pendingStops.fetch_and(~bit, std::memory_order_relaxed);
+    pendingStarts.fetch_or(bit, std::memory_order_release);
+}
+
+void MixerCore::stop(Voice voice) {
+    const uint32_t bit = 1u << static_cast<int>(voice);
+    pendingStarts.fetch_and(~bit, std::memory_order_relaxed);
+    pendingStops.fetch_or(bit, std::memory_order_release);
+}
+
+void MixerCore::recordLatency(int64_t latencyNs) {
+    ++latencyCount;
+    latencySumNs += static_cast<double>(latencyNs);
+    latencyWorstNs = std::max(latencyWorstNs, static_cast<double>(latencyNs));
+}
+
+void MixerCore::startVoice(Voice voice, bool loop, int64_t latencyNs) {
+    VoiceState& state = voices[static_cast<int>(voice)];
+    state.position = 0;
+    state.playing = !state.pcm.empty();
+    state.looping = loop;
+    recordLatency(latencyNs);
+}
+
+void MixerCore::stopVoice(Voice voice) {
+    voices[static_cast<int>(voice)].playing = false;
+}
+
+void MixerCore::silenceGame() {
+    soundEvents.read(nullptr, EVENT_CAPACITY);
+    synth.reset();
+    for (int v = 0; v < VOICE_COUNT; ++v) {
+        if (voices[v].looping) {
+            stopVoice(static_cast<Voice>(v));
+        }
+    }
+    anchored = false;
+}
+
+void MixerCore::applyPortWrite(const SoundEvent& event, int64_t latencyNs) {
+    const uint8_t newBits = ~event.oldValue & event.newValue;
+
+    // The circuits decode the latches themselves
+    if (mode == SoundMode::Synthesis) {
+        synth.writePort(event.port, event.newValue);
+        if (newBits) {
+            recordLatency(latencyNs);
+        }
+        return;
+    }
+
+    if (event.port == 3) {
+        // The UFO loops while its bit is held and stops when it drops
+        if (newBits & UFO) {
+            startVoice(Voice::Ufo, true, latencyNs);
+        }
+        if (!(event.newValue & UFO)) {
+            stopVoice(Voice::Ufo);
+        }
+        if (newBits & SHOTS) {
+            startVoice(Voice::Shot, false, latencyNs);
+        }
+        if (newBits & PLAYER_DIE) {
+            startVoice(Voice::PlayerDie, false, latencyNs);
+        }
+        if (newBits & INVADER_DIE) {
+            startVoice(Voice::InvaderDie, false, latencyNs);
+        }
+    } else if (event.port == 5) {
+        if (newBits & FLEET1) {
+            startVoice(Voice::Fleet1, false, latencyNs);
+        }
+        if (newBits & FLEET2) {
+            startVoice(Voice::Fleet2, false, latencyNs);
+        }
+        if (newBits & FLEET3) {
+            startVoice(Voice::Fleet3, false, latencyNs);
+        }
+        if (newBits & FLEET4) {
+            startVoice(Voice::Fleet4, false, latencyNs);
+        }
+        if (newBits & UFO_HIT) {
+            startVoice(Voice::UfoHit, false, latencyNs);
+        }
+    }
+}
+
+int64_t MixerCore::eventOffset(uint64_t cycle) {
+    int64_t offset = 0;
+    if (anchored) {
+        const int64_t cycles = static_cast<int64_t>(cycle - anchorCycle);
+        const int64_t frame = static_cast<int64_t>(anchorFrame) + cycles * SAMPLE_RATE / cycleClockHz;
+        offset = frame - static_cast<int64_t>(renderedFrames);
+    }
+
+    if (!anchored || offset < -LATE_TOLERANCE_FRAMES || offset > MAX_AHEAD_FRAMES) {
+        // First write, or the emulator and the audio device have drifted apart
+        anchorAt(cycle);
+        offset = SCHEDULE_DELAY_FRAMES;
+    }
+    return offset;
+}
+
+void MixerCore::anchorAt(uint64_t cycle) {
+    anchored = true;
+    anchorCycle = cycle;
+    anchorFrame = renderedFrames + SCHEDULE_DELAY_FRAMES;
+    ++reanchors;
+}
+
+void MixerCore::grantCycles(int frames, const std::atomic<uint64_t>* clock) {
+    const uint64_t cyclesNow = clock->load(std::memory_order_acquire);
+
+    // Where the emulator is on the output timeline, relative to the next block
+    double lead = SCHEDULE_DELAY_FRAMES;
+    if (anchored) {
+        const double cycles = static_cast<double>(static_cast<int64_t>(cyclesNow - anchorCycle));
+        lead = static_cast<double>(anchorFrame) + cycles * SAMPLE_RATE / cycleClockHz - static_cast<double>(renderedFrames);
+    }
+    if (!anchored || lead < -LATE_TOLERANCE_FRAMES || lead > MAX_AHEAD_FRAMES) {
+        // Not started yet, or back from a pause: start again at the target lead
+        anchorAt(cyclesNow);
+        lead = SCHEDULE_DELAY_FRAMES;
+    }
+
+    // Proportional control, clamped so the pitch and tempo change is inaudible
+    const double error = (SCHEDULE_DELAY_FRAMES - lead) / PERIOD_FRAMES;
+    pacingRate = 1.0 + std::clamp(PACING_GAIN * error, -MAX_RATE_ADJUST, MAX_RATE_ADJUST);
+    pacingLeadFrames = lead;
+
+    const double exact = static_cast<double>(frames) * cycleClockHz / SAMPLE_RATE * pacingRate + creditRemainder;
+    const int64_t grant = static_cast<int64_t>(exact);
+    creditRemainder = exact - grant;
+
+    // Credit the emulator has not used is capped, so it never sprints to catch up
+    const int64_t maxCredit = static_cast<int64_t>(MAX_CREDIT_FRAMES) * cycleClockHz / SAMPLE_RATE;
+    int64_t credit = cycleCredit.load(std::memory_order_relaxed);
+    while (!cycleCredit.compare_exchange_weak(credit, std::min(credit + grant, maxCredit), std::memory_order_release)) {
+    }
+}
+
+void MixerCore::applyTriggers(int64_t outputDelayNs) {
+    const uint32_t stops = pendingStops.exchange(0, std::memory_order_acquire);
+    const uint32_t starts = pendingStarts.exchange(0, std::memory_order_acquire);
+    if (!(stops | starts)) {
+        return;
+    }
+    const uint32_t loops = pendingLoops.load(std::memory_order_relaxed);
+    const int64_t now = nowNs();
+
+    for (int v = 0; v < VOICE_COUNT; ++v) {
+        const uint32_t bit = 1u << v;
+        if (stops & bit) {
+            stopVoice(static_cast<Voice>(v));
+        }
+        if (starts & bit) {
+            const int64_t latency = now - triggerTimes[v].load(std::memory_order_relaxed) + outputDelayNs;
+            startVoice(static_cast<Voice>(v), (loops & bit) != 0, latency);
+        }
+    }
+}
+
+void MixerCore::mixVoice(VoiceState& voice, int16_t* out, int frames) {
+    int done = 0;
+    while (done < frames) {
+        const int count = static_cast<int>(std::min<size_t>(frames - done, voice.pcm.size() - voice.position));
+        mixInto(out + done, voice.pcm.data() + voice.position, count);
+        voice.position += count;
+        done += count;
+
+        if (voice.position >= voice.pcm.size()) {
+            voice.position = 0;
+            if (!voice.looping) {
+                voice.playing = false;
+                return;
+            }
+        }
+    }
+}
+
+void MixerCore::mixVoices(int16_t* out, int frames) {
+    for (VoiceState& voice : voices) {
+        if (voice.playing) {
+            mixVoice(voice, out, frames);
+        }
+    }
+}
+
+void MixerCore::mixSegment(int16_t* out, int frames) {
+    mixVoices(out, frames);
+    if (mode == SoundMode::Synthesis) {
+        synth.render(out, frames);
+    }
+}
+
+void MixerCore::mixMusic(int16_t* out, int frames) {
+    if (!musicPlaying.load(std::memory_order_acquire)) {
+        musicRing.read(nullptr, musicRing.readAvailable());
+        return;
+    }
+    // A starved stream just plays silence until the feeder catches up
+    for (int done = 0; done < frames;) {
+        const size_t count = musicRing.read(musicBlock, std::min(frames - done, PERIOD_FRAMES));
+        if (count == 0) {
+            return;
+        }
+        mixInto(out + done, musicBlock, static_cast<int>(count));
+        done += static_cast<int>(count);
+    }
+}
+
+void MixerCore::render(int16_t* out, int frames, int64_t outputDelayNs) {
+    rendering.store(true); // Before the clock is loaded; see setCycleClock()
+    if (pendingDetach.exchange(false, std::memory_order_acquire)) {
+        silenceGame();
+    }
+    outputQueueNs.store(outputDelayNs, std::memory_order_relaxed);
+    std::memset(out, 0, sizeof(int16_t) * frames);
+    mixMusic(out, frames);
+    applyTriggers(outputDelayNs);
+
+    const std::atomic<uint64_t>* clock = cycleClock.load();
+    const uint64_t cyclesNow = clock ? clock->load(std::memory_order_acquire) : 0;
+
+    // Mix up to each port write that falls in this block, apply it at its
+    // own sample, and carry on. Later writes stay queued for their block.
+    int cursor = 0;
+    while (const SoundEvent* next = soundEvents.peek()) {
+        int64_t offset = eventOffset(next->cycle);
+        if (offset >= frames) {
+            break;
+        }
+        if (offset < cursor) {
+            ++lateEvents;
+            offset = cursor;
+        }
+
+        SoundEvent event;
+        soundEvents.pop(event);
+        mixSegment(out + cursor, static_cast<int>(offset) - cursor);
+        cursor = static_cast<int>(offset);
+
+        // From the emulated OUT to the sample reaching the speaker
+        int64_t latency = outputDelayNs + offset * 1000000000LL / SAMPLE_RATE;
+        if (cyclesNow > event.cycle) {
+            latency += static_cast<int64_t>((cyclesNow - event.cycle) * 1000000000ULL / cycleClockHz);
+        }
+        applyPortWrite(event, latency);
+    }
+    mixSegment(out + cursor, frames - cursor);
+
+    if (WavRecorder* wavRecorder = recorder.load(std::memory_order_acquire)) {
+        wavRecorder->write(out, static_cast<size_t>(frames));
+    }
+
+    renderedFrames += frames;
+    if (clock && pacing.load(std::memory_order_acquire)) {
+        grantCycles(frames, clock);
+    }
+    rendering.store(false, std::memory_order_release);
+}
+
+MixerCore::LatencyStats MixerCore::takeLatencyStats() {
+    LatencyStats stats = {
+        latencyCount,
+        latencyCount ? latencySumNs / latencyCount / 1000.0 : 0.0,
+        latencyWorstNs / 1000.0,
+        lateEvents,
+        reanchors
+    };
+    lateEvents = 0;
+    reanchors = 0;
+    latencyCount = 0;
+    latencySumNs = 0.0;
+    latencyWorstNs = 0.0;
+    return stats;
+}
@@ -0,0 +1,315 @@
+#ifndef MIXERCORE_H
+#define MIXERCORE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "spscring.h"
+#include "soundsynth.h"
+
+class WavRecorder;
+
+/**
+ * @brief One playable sound, indexed directly instead of by file name.
+ *
+ * The order follows the port 3 and port 5 bits in io_bits.h.
+ */
+enum class Voice : uint8_t {
+    Ufo,
+    Shot,
+    PlayerDie,
+    InvaderDie,
+    Fleet1,
+    Fleet2,
+    Fleet3,
+    Fleet4,
+    UfoHit,
+    Count
+};
+
+/**
+ * @brief Where the sound port writes are turned into audio.
+ */
+enum class SoundMode {
+    Samples,  ///< Play the WAV recordings from the sounds folder.
+    Synthesis ///< Model the discrete sound circuits (SoundSynth).
+};
+
+/**
+ * @brief A write to sound port 3 or 5, as seen by the emulated CPU.
+ */
+struct SoundEvent {
+    uint64_t cycle;   ///< CPU cycle count when the OUT executed.
+    uint8_t port;     ///< 3 or 5.
+    uint8_t oldValue; ///< Port latch before the write.
+    uint8_t newValue; ///< Value written.
+};
+
+/**
+ * @brief Sample file played for a voice, relative to the sounds resource folder.
+ */
+const char* voiceFileName(Voice voice);
+
+/**
+ * @brief Software mixer for the sound effects.
+ *
+ * Holds every effect as 48 kHz mono PCM and mixes the playing voices into
+ * 16-bit output blocks. Port writes from the emulator arrive through a
+ * single-producer ring and are decoded into voices on the audio thread;
+ * trigger() and stop() may be called from any other thread. Both paths are
+ * lock-free, and render() runs on the audio thread only and never allocates.
+ *
+ * Port writes are scheduled sample-accurately: the emulated cycle of each
+ * OUT is mapped onto the output sample clock through an anchor (one cycle
+ * paired with one sample), so sounds keep the spacing they had in the
+ * emulation however the threads happen to be scheduled. The anchor is reset
+ * when the two clocks slip too far apart, e.g. after a pause or a new game.
+ *
+ * Optionally the output clock also paces the emulator: every rendered block
+ * grants the cycles it stands for, so the two clocks cannot drift apart.
+ *
+ * Background music is streamed in through a second ring, already decoded
+ * to the output format, and mixed under the effects.
+ *
+ * Every rendered block can also be handed to a WavRecorder. Because mixing
+ * only depends on the emulated cycle stamps, rendering in lockstep with an
+ * unpaced emulator produces the same audio faster than real time.
+ */
+class MixerCore {
+public:
+    static constexpr int SAMPLE_RATE = 48000;
+    static constexpr int PERIOD_FRAMES = SAMPLE_RATE / 100; ///< 10 ms
+    static constexpr int VOICE_COUNT = static_cast<int>(Voice::Count);
+    static constexpr int SCHEDULE_DELAY_FRAMES = PERIOD_FRAMES;    ///< Headroom for events still in flight
+    static constexpr int LATE_TOLERANCE_FRAMES = PERIOD_FRAMES / 2; ///< Lateness absorbed without re-anchoring
+    static constexpr int MAX_AHEAD_FRAMES = 8 * PERIOD_FRAMES;      ///< Further ahead than this means the clocks slipped
+    static constexpr double MAX_RATE_ADJUST = 0.005; ///< Pacing may run the emulator up to 0.5% fast or slow
+    static constexpr double PACING_GAIN = 0.01;      ///< Rate change per period of lead error
+    static constexpr int MAX_CREDIT_FRAMES = 2 * PERIOD_FRAMES; ///< Unused credit kept when the emulator stalls
+    static constexpr size_t MUSIC_RING_FRAMES = 8192;            ///< About 170 ms of streamed music
+
+    MixerCore();
+
+    /**
+     * @brief Selects samples or circuit synthesis. Call before output starts.
+     */
+    void setMode(SoundMode soundMode) { mode = soundMode; }
+    SoundMode soundMode() const { return mode; }
+
+    static const char* modeName(SoundMode soundMode);
+    static SoundMode modeFromName(const std::string& name, SoundMode fallback = SoundMode::Samples);
+
+    /**
+     * @brief Installs the PCM for a voice. Call before output starts or on the thread that renders.
+     */
+    void setSample(Voice voice, std::vector<int16_t> pcm);
+
+    /**
+     * @brief Queues a sound port write. Emulator thread only.
+     *
+     * Writes that do not change the latch are ignored. If the audio thread has
+     * fallen so far behind that the ring is full the write is dropped and counted.
+     */
+    void postPortWrite(uint64_t cycle, uint8_t port, uint8_t oldValue, uint8_t newValue) {
+        if (oldValue != newValue && !soundEvents.push({ cycle, port, oldValue, newValue })) {
+            droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Lets the mixer read the emulator's published cycle count.
+     *
+     * Used to measure the latency of port writes; pass null before the
+     * counter goes away. Detaching waits until the audio thread has left
+     * render(), so the counter may be freed as soon as this returns. Never
+     * call it from the thread that renders.
+     *
+     * Detaching also ends the game's sound: the next block drops its queued
+     * port writes, resets the synthesised circuits and stops looping voices,
+     * so a latched UFO does not drone on under the menu music.
+     */
+    void setCycleClock(const std::atomic<uint64_t>* cycles, int cyclesPerSecond);
+
+    /**
+     * @brief Queues decoded music (48 kHz mono). Feeder thread only.
+     * @return Samples accepted; offer the rest again once there is room.
+     */
+    size_t pushMusic(const int16_t* samples, size_t count) { return musicRing.write(samples, count); }
+
+    /**
+     * @brief Music samples that can be queued right now. Feeder thread only.
+     */
+    size_t musicSpace() const { return musicRing.writeAvailable(); }
+
+    /**
+     * @brief Starts or stops mixing the music; while stopped, queued music is discarded.
+     */
+    void setMusicPlaying(bool playing) { musicPlaying.store(playing, std::memory_order_release); }
+
+    /**
+     * @brief Sends every rendered block to recorder as well (null to stop).
+     *
+     * Detach before stopping the recorder; the last block may still be in flight.
+     */
+    void setRecorder(WavRecorder* wavRecorder) { recorder.store(wavRecorder, std::memory_order_release); }
+
+    /**
+     * @brief Lets the audio output pace the emulator ("emulation_clock": "audio").
+     *
+     * Each rendered block grants the emulator the cycles it represents, scaled
+     * by up to MAX_RATE_ADJUST so the emulator stays SCHEDULE_DELAY_FRAMES
+     * ahead of the output. Needs the cycle clock from setCycleClock().
+     */
+    void setPacing(bool enabled) { pacing.store(enabled, std::memory_order_release); }
+    bool isPacing() const { return pacing.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Collects the cycles granted since the previous call. Emulator thread only.
+     */
+    int64_t takeCycleCredit() { return cycleCredit.exchange(0, std::memory_order_acquire); }
+
+    /**
+     * @brief Current pacing rate and emulator lead; audio thread only.
+     */
+    struct PacingStats {
+        double rate;   ///< Emulated seconds per output second.
+        double leadMs; ///< How far the emulator is ahead of the output.
+    };
+    PacingStats pacingStats() const { return { pacingRate, pacingLeadFrames * 1000.0 / SAMPLE_RATE }; }
+
+    /**
+     * @brief Port writes lost to a full ring since the previous call.
+     */
+    uint64_t takeDroppedEvents() { return droppedEvents.exchange(0, std::memory_order_relaxed); }
+
+    /**
+     * @brief Audio the output had queued at the last render, in milliseconds. Safe from any thread.
+     */
+    double outputQueuedMs() const { return outputQueueNs.load(std::memory_order_relaxed) / 1.0e6; }
+
+    /**
+     * @brief Starts a voice from the beginning at the next render.
+     * @param loop Repeat until stop() is called (the UFO drone).
+     */
+    void trigger(Voice voice, bool loop = false);
+
+    /**
+     * @brief Silences a voice at the next render.
+     */
+    void stop(Voice voice);
+
+    /**
+     * @brief Mixes the next block of output.
+     * @param out Destination, frames mono samples.
+     * @param frames Number of samples to produce.
+     * @param outputDelayNs Audio already queued ahead of this block, used for latency figures.
+     */
+    void render(int16_t* out, int frames, int64_t outputDelayNs);
+
+    /**
+     * @brief Trigger-to-output latency since the previous call.
+     *
+     * Measured from trigger() or the emulated OUT to the moment the voice's
+     * first sample reaches the output, i.e. time until the next render plus
+     * audio queued ahead of it.
+     */
+    struct LatencyStats {
+        uint64_t triggers;
+        double averageMicroseconds;
+        double worstMicroseconds;
+        uint64_t lateEvents; ///< Port writes that arrived after their sample had been rendered.
+        uint64_t reanchors;  ///< Times the cycle-to-sample mapping was reset.
+    };
+    LatencyStats takeLatencyStats();
+
+private:
+    struct VoiceState {
+        std::vector<int16_t> pcm;
+        size_t position = 0;
+        bool playing = false;
+        bool looping = false;
+    };
+
+    std::array<VoiceState, VOICE_COUNT> voices;
+    SoundMode mode;
+    SoundSynth synth;
+
+    static constexpr size_t EVENT_CAPACITY = 256; ///< Far more than a frame's worth of port writes
+    SpscRing<SoundEvent, EVENT_CAPACITY> soundEvents;
+    std::atomic<uint64_t> droppedEvents;
+    std::atomic<int64_t> outputQueueNs;
+    std::atomic<const std::atomic<uint64_t>*> cycleClock;
+    std::atomic<bool> rendering; ///< render() is running and may hold the clock pointer
+    std::atomic<bool> pendingDetach; ///< The emulator went away; silence its sound at the next block
+    int cycleClockHz;
+
+    // Pending commands, one bit per voice. A later trigger clears an earlier
+    // stop and vice versa, so the last request in a period wins.
+    std::atomic<uint32_t> pendingStarts;
+    std::atomic<uint32_t> pendingLoops;
+    std::atomic<uint32_t> pendingStops;
+    std::array<std::atomic<int64_t>, VOICE_COUNT> triggerTimes; ///< steady_clock ns of the last trigger
+
+    uint64_t latencyCount;
+    double latencySumNs;
+    double latencyWorstNs;
+    uint64_t lateEvents;
+    uint64_t reanchors;
+
+    // Cycle-to-sample mapping, audio thread only
+    uint64_t renderedFrames; ///< Output samples produced so far; the first sample of the next block.
+    bool anchored;
+    uint64_t anchorCycle;
+    uint64_t anchorFrame;
+
+    // Streamed background music
+    SpscRing<int16_t, MUSIC_RING_FRAMES> musicRing;
+    std::atomic<bool> musicPlaying;
+    int16_t musicBlock[PERIOD_FRAMES];
+    void mixMusic(int16_t* out, int frames);
+
+    std::atomic<WavRecorder*> recorder;
+
+    // Audio-clock pacing
+    std::atomic<bool> pacing;
+    std::atomic<int64_t> cycleCredit;
+    double creditRemainder; ///< Fraction of a cycle carried to the next grant
+    double pacingRate;
+    double pacingLeadFrames;
+
+    /**
+     * @brief Grants the cycles for a rendered block, steering the emulator towards its target lead.
+     */
+    void grantCycles(int frames, const std::atomic<uint64_t>* clock);
+
+    /**
+     * @brief Pairs a cycle with the sample one scheduling delay ahead of the next block.
+     */
+    void anchorAt(uint64_t cycle);
+
+    /**
+     * @brief Offset of a port write from the start of the block being rendered.
+     *
+     * Re-anchors when the write is far later or earlier than the mapping predicts.
+     */
+    int64_t eventOffset(uint64_t cycle);
+
+    /**
+     * @brief Forgets the detached game's port writes, latches and looping voices.
+     */
+    void silenceGame();
+
+    void applyTriggers(int64_t outputDelayNs);
+    void applyPortWrite(const SoundEvent& event, int64_t latencyNs);
+    void recordLatency(int64_t latencyNs);
+    void startVoice(Voice voice, bool loop, int64_t latencyNs);
+    void stopVoice(Voice voice);
+    void mixVoice(VoiceState& voice, int16_t* out, int frames);
+    void mixVoices(int16_t* out, int frames);
+    void mixSegment(int16_t* out, int frames);
+};
+
+#endif // MIXERCORE_H
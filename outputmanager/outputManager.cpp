@@ -1,7 +1,13 @@
 #include "outputManager.h"
-#include "../emulator/io_bits.h"
 #include "../emulator/emulatorWrapper.h"
+#include "../diagnostics/chrometrace.h"
+#include "../diagnostics/threadcpu.h"
 #include <QDebug>
+#include <algorithm>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 OutputManager* OutputManager::instance = nullptr;
 QMutex OutputManager::mutex;
@@ -25,9 +31,11 @@ void OutputManager::destroyInstance() {
 }
 
 OutputManager::OutputManager(QObject* parent)
-    : QObject(parent), videoMemory(nullptr), audioMixer(nullptr) {
+    : QObject(parent), videoMemory(nullptr), audioMixer(nullptr), videoSuspended(false), beamRacing(false), presentedScanline(0) {
     qDebug() << "Starting Output Manager";
 
+    loadSettings();
+
     // Create a dedicated thread for the timer
     timerThread = new QThread(this);
 
@@ -35,16 +43,31 @@ OutputManager::OutputManager(QObject* parent)
     frameTimer = new QTimer();
     frameTimer->moveToThread(timerThread);
 
-    // Connect the timer's timeout signal to emit frameReady
-    connect(frameTimer, &QTimer::timeout, this, &OutputManager::frameReady);
+    if (beamRacing) {
+        // Sample the beam on the timer thread and present bands as they complete
+        frameTimer->setTimerType(Qt::PreciseTimer);
+        connect(frameTimer, &QTimer::timeout, frameTimer, [this]() { pollBeam(); });
+    } else {
+        // Emit frameReady on every tick; the instant marks when the frame was queued to the GUI
+        connect(frameTimer, &QTimer::timeout, frameTimer, [this]() {
+            ChromeTrace::instant("frame ready");
+            emit frameReady();
+        });
+    }
 
-    // Start the timer when the thread starts
+    // Start the timer when the thread starts, unless the window is already hidden
     connect(timerThread, &QThread::started, frameTimer, [=]() {
-        frameTimer->start(16); // Roughly 60 FPS (16ms interval)
+        ChromeTrace::setThreadName("video timer");
+        ThreadCpu::registerCurrentThread("video timer");
+        if (!videoSuspended) {
+            frameTimer->start(timerInterval());
+        }
     });
 
-    // Stop the timer and clean up when the thread finishes
+    // Stop the timer and clean up when the thread finishes; finished is emitted on the thread itself
     connect(timerThread, &QThread::finished, frameTimer, &QTimer::stop);
+    connect(timerThread, &QThread::finished, frameTimer, []() { ThreadCpu::unregisterCurrentThread(); },
+            Qt::DirectConnection);
     qDebug() << "Output Manager started successfully";
 }
 
@@ -66,6 +89,52 @@ OutputManager::~OutputManager() {
     qDebug() << "OutputManager destroyed successfully.";
 }
 
+void OutputManager::loadSettings() {
+    QFile settingsFile(QDir::currentPath() + "/.settings.json");
+    if (settingsFile.open(QIODevice::ReadOnly)) {
+        QJsonObject jsonObject = QJsonDocument::fromJson(settingsFile.readAll()).object();
+        beamRacing = jsonObject["beam_racing"].toBool(false);
+    }
+    qDebug() << "Beam racing" << (beamRacing ? "enabled" : "disabled");
+}
+
+int64_t OutputManager::beamScanline() const {
+    using EW = EmulatorWrapper;
+    const int64_t cycles = static_cast<int64_t>(EW::getInstance().getCycleCount());
+    return cycles * EW::SCANLINES_PER_FRAME / EW::CYCLES_PER_FRAME;
+}
+
+void OutputManager::pollBeam() {
+    using EW = EmulatorWrapper;
+    CHROME_TRACE_SCOPE("poll beam");
+    const int64_t beam = beamScanline();
+
+    // If we fell more than a frame behind (paused, hidden, stalled), restart at the current frame
+    // and redraw all of it once instead of replaying stale bands.
+    if (beam - presentedScanline > EW::SCANLINES_PER_FRAME) {
+        presentedScanline = beam - beam % EW::SCANLINES_PER_FRAME;
+        emit scanlinesReady(0, EW::VISIBLE_SCANLINES);
+    }
+
+    while (presentedScanline < beam) {
+        const int64_t frameStart = presentedScanline - presentedScanline % EW::SCANLINES_PER_FRAME;
+        const int line = static_cast<int>(presentedScanline - frameStart);
+
+        // Vertical blank, nothing to present until the next frame starts
+        if (line >= EW::VISIBLE_SCANLINES) {
+            presentedScanline = frameStart + EW::SCANLINES_PER_FRAME;
+            continue;
+        }
+
+        const int bandEnd = std::min((line / BEAM_BAND_SCANLINES + 1) * BEAM_BAND_SCANLINES, EW::VISIBLE_SCANLINES);
+        if (frameStart + bandEnd > beam) {
+            break; // The beam is still inside this band
+        }
+        emit scanlinesReady(line, bandEnd);
+        presentedScanline = frameStart + bandEnd;
+    }
+}
+
 void OutputManager::initializeVideo() {
     videoMemory = EmulatorWrapper::getInstance().getVideoMemory();
     if (!videoMemory) {
@@ -82,6 +151,31 @@ void OutputManager::startVideo() {
     }
 }
 
+void OutputManager::setVideoSuspended(bool suspended) {
+    if (videoSuspended.exchange(suspended) == suspended) {
+        return;
+    }
+    qDebug() << "Video output" << (suspended ? "suspended." : "resumed.");
+
+    // Not started yet; the thread's started handler honours the flag
+    if (!timerThread->isRunning()) {
+        return;
+    }
+
+    // The timer belongs to the video thread, so stop and restart it there
+    QMetaObject::invokeMethod(frameTimer, [this, suspended]() {
+        if (suspended) {
+            frameTimer->stop();
+            return;
+        }
+        // The widget redraws the whole frame on resume; carry on from the current beam position
+        if (beamRacing) {
+            presentedScanline = beamScanline();
+        }
+        frameTimer->start(timerInterval());
+    }, Qt::QueuedConnection);
+}
+
 const uint8_t* OutputManager::getFrame() const {
     if (!videoMemory) {
         qCritical() << "Error: Video memory not initialized!";
@@ -103,56 +197,3 @@ void OutputManager::setAudioMixer(AudioMixer* mixer) {
     audioMixer = mixer;
     qDebug() << "AudioMixer set in OutputManager";
 }
-
-void OutputManager::handleSoundUpdates(uint8_t port_num, uint8_t old_value, uint8_t new_value) {
-    // Don't bother processing if nothing has changed
-    if (old_value == new_value){
-        return;
-    }
-
-    uint8_t new_bits = ~old_value & new_value;
-
-    // Port 3 sounds
-    if (port_num == 3){
-
-        //Special Handling for UFO
-        //Loop it if a new bit arrives
-        //Turn it off if the newly arrived port bit for it is 0
-        if (new_bits & UFO) {
-        AudioMixer::getInstance()->playSoundEffect("ufo_lowpitch.wav", true);
-        }
-        if (!(new_value & UFO)) {
-        AudioMixer::getInstance()->stopSoundEffect("ufo_lowpitch.wav");
-        }
-
-        // Regular Port 3 handling
-        if (new_bits & SHOTS) {
-        AudioMixer::getInstance()->playSoundEffect("shoot.wav");
-        }
-        if (new_bits & PLAYER_DIE) {
-        AudioMixer::getInstance()->playSoundEffect("explosion.wav");
-        }
-        if (new_bits & INVADER_DIE) {
-        AudioMixer::getInstance()->playSoundEffect("invaderkilled.wav");
-        }
-    }
-
-    // Port 5 sounds
-    if (port_num == 5){
-        if (new_bits & FLEET1) {
-        AudioMixer::getInstance()->playSoundEffect("fastinvader1.wav");
-        }
-        if (new_bits & FLEET2) {
-        AudioMixer::getInstance()->playSoundEffect("fastinvader2.wav");
-        }
-        if (new_bits & FLEET3) {
-        AudioMixer::getInstance()->playSoundEffect("fastinvader3.wav");
-        }
-        if (new_bits & FLEET4) {
-        AudioMixer::getInstance()->playSoundEffect("fastinvader4.wav");
-        }
-        if (new_bits & UFO_HIT) {
-        AudioMixer::getInstance()->playSoundEffect("ufo_highpitch.wav");
-        }
-    }
-}
@@ -7,6 +7,7 @@
 #include <QTimer>
 #include <QThread>
 #include <QMutex>
+#include <atomic>
 #include "audiomixer.h"
 
 
@@ -28,17 +29,32 @@ public:
     void startVideo();
     void stopVideo();
 
+    /**
+     * @brief True when frames are presented in bands that follow the emulated beam.
+     */
+    bool isBeamRacing() const { return beamRacing; }
+
+    /**
+     * @brief Stops (or restarts) frame signals while nobody can see the picture.
+     *
+     * Emulation is unaffected; only the frame timer on the video thread is halted.
+     * Safe to call from the GUI thread while the video thread is running.
+     */
+    void setVideoSuspended(bool suspended);
+    bool isVideoSuspended() const { return videoSuspended; }
+
     // Audio-related methods
     void setAudioMixer(AudioMixer* mixer);
-    void playSoundEffect(const QString& filePath, bool loop);
     void startBackgroundMusic();
     void stopBackgroundMusic();
 
-    void handleSoundUpdates(uint8_t port_num, uint8_t old_val, uint8_t new_val);
-
 signals:
     void frameReady(); // Forwarded signal for frame updates
 
+    // Beam racing: scanlines [firstScanline, lastScanline) of the current frame are complete.
+    // Scanlines are video RAM rows, i.e. displayed columns of the upright screen.
+    void scanlinesReady(int firstScanline, int lastScanline);
+
 private:
     explicit OutputManager(QObject* parent = nullptr);
     ~OutputManager();
@@ -50,6 +66,20 @@ private:
     QThread* timerThread;  ///< Thread for the timer
     const uint8_t* videoMemory; ///< Pointer to video memory
     AudioMixer* audioMixer;     ///< Pointer to the AudioMixer instance
+    std::atomic<bool> videoSuspended; ///< Set while the window is hidden or minimized
+
+    static constexpr int FRAME_INTERVAL_MS = 16; ///< Roughly 60 FPS
+
+    // Beam racing
+    static constexpr int BEAM_BAND_SCANLINES = 16; ///< Scanlines converted and presented together
+    static constexpr int BEAM_POLL_MS = 1;         ///< How often the beam position is sampled
+    bool beamRacing;
+    int64_t presentedScanline; ///< Absolute scanline (frame * SCANLINES_PER_FRAME + line) presented so far
+
+    void loadSettings();
+    int timerInterval() const { return beamRacing ? BEAM_POLL_MS : FRAME_INTERVAL_MS; }
+    int64_t beamScanline() const; ///< Absolute scanline the emulated beam has reached
+    void pollBeam(); ///< Runs on the timer thread; emits scanlinesReady for completed bands
 };
 
 #endif // OUTPUTMANAGER_H
@@ -0,0 +1,202 @@
+#include "pixelscaler.h"
+#include "pixelscaler_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXELSCALER_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+using namespace PixelScalerKernels;
+
+namespace {
+
+#ifdef PIXELSCALER_HAVE_SSE2
+struct Sse2 {
+    using T = __m128i;
+    static constexpr int N = 16;
+
+    static T load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(uint8_t* p, T v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static T eq(T a, T b) { return _mm_cmpeq_epi8(a, b); }
+    static T lt(T a, T b) { return _mm_cmplt_epi8(a, b); }
+    static T and_(T a, T b) { return _mm_and_si128(a, b); }
+    static T or_(T a, T b) { return _mm_or_si128(a, b); }
+    static T andnot(T a, T b) { return _mm_andnot_si128(a, b); }
+    static T add(T a, T b) { return _mm_adds_epu8(a, b); }
+    static T avg(T a, T b) { return _mm_avg_epu8(a, b); }
+    static T max(T a, T b) { return _mm_max_epu8(a, b); }
+    static T set1(int v) { return _mm_set1_epi8(static_cast<char>(v)); }
+
+    static void storeInterleaved2(uint8_t* p, T a, T b) {
+        store(p, _mm_unpacklo_epi8(a, b));
+        store(p + N, _mm_unpackhi_epi8(a, b));
+    }
+};
+
+const KernelSet sse2Kernels = { "sse2", &scale2x<Sse2>, &scale3x<Sse2>, &xbr2x<Sse2> };
+#endif
+
+const KernelSet scalarKernels = {
+    "scalar",
+    &scalarColumns<scale2xPixel>,
+    &scalarColumns<scale3xPixel>,
+    &scalarColumns<xbr2xPixel>
+};
+
+bool hostSupportsAvx2() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    return avx2 && osxsave && (_xgetbv(0) & 0x6) == 0x6;
+#else
+    return false;
+#endif
+}
+
+const KernelSet& activeKernels() {
+    static const KernelSet& kernels = []() -> const KernelSet& {
+        if (avx2Kernels.scale2x && hostSupportsAvx2()) {
+            return avx2Kernels;
+        }
+#ifdef PIXELSCALER_HAVE_SSE2
+        return sse2Kernels;
+#else
+        return scalarKernels;
+#endif
+    }();
+    return kernels;
+}
+
+void copyColumns(const VideoFrame& src, uint8_t* dst, int dstStride, int x0, int x1) {
+    for (int y = 0; y < src.height(); ++y) {
+        std::memcpy(dst + y * dstStride + x0, src.row(y) + x0, x1 - x0);
+    }
+}
+
+} // namespace
+
+PixelScaler::PixelScaler(Filter filter)
+    : currentFilter(filter),
+    intermediate(VideoConverter::SCREEN_WIDTH * 2, VideoConverter::SCREEN_HEIGHT * 2)
+{
+}
+
+void PixelScaler::setFilter(Filter filter) {
+    currentFilter = filter;
+}
+
+void PixelScaler::scale(const VideoFrame& src, uint8_t* dst, int dstStride, int firstColumn, int lastColumn) {
+    firstColumn = std::max(firstColumn, 0);
+    lastColumn = std::min(lastColumn, src.width());
+    if (firstColumn >= lastColumn) {
+        return;
+    }
+
+    const KernelSet& kernels = activeKernels();
+    switch (currentFilter) {
+    case Filter::None:
+        copyColumns(src, dst, dstStride, firstColumn, lastColumn);
+        break;
+    case Filter::Scale2x:
+        kernels.scale2x(src, dst, dstStride, firstColumn, lastColumn);
+        break;
+    case Filter::Scale3x:
+        kernels.scale3x(src, dst, dstStride, firstColumn, lastColumn);
+        break;
+    case Filter::Scale4x: {
+        // The second pass reads one intermediate column either side of the
+        // band, so widen the first pass by one source column.
+        const int x0 = std::max(firstColumn - 1, 0);
+        const int x1 = std::min(lastColumn + 1, src.width());
+        uint8_t* mid = intermediate.row(0);
+        kernels.scale2x(src, mid, intermediate.stride(), x0, x1);
+        kernels.scale2x(intermediate, dst, dstStride, 2 * firstColumn, 2 * lastColumn);
+        break;
+    }
+    case Filter::XBR:
+        kernels.xbr2x(src, dst, dstStride, firstColumn, lastColumn);
+        break;
+    }
+}
+
+int PixelScaler::factorOf(Filter filter) {
+    switch (filter) {
+    case Filter::Scale2x: return 2;
+    case Filter::Scale3x: return 3;
+    case Filter::Scale4x: return 4;
+    case Filter::XBR: return 2;
+    case Filter::None: break;
+    }
+    return 1;
+}
+
+const char* PixelScaler::filterName(Filter filter) {
+    switch (filter) {
+    case Filter::Scale2x: return "scale2x";
+    case Filter::Scale3x: return "scale3x";
+    case Filter::Scale4x: return "scale4x";
+    case Filter::XBR: return "xbr";
+    case Filter::None: break;
+    }
+    return "none";
+}
+
+PixelScaler::Filter PixelScaler::filterFromName(const std::string& name, Filter fallback) {
+    for (Filter f : { Filter::None, Filter::Scale2x, Filter::Scale3x, Filter::Scale4x, Filter::XBR }) {
+        if (name == filterName(f)) {
+            return f;
+        }
+    }
+    return fallback;
+}
+
+const char* PixelScaler::backendName() {
+    return activeKernels().name;
+}
+
+std::vector<PixelScaler::BenchmarkResult> PixelScaler::benchmark(int frames) {
+    // Sparse pseudo-random video RAM; roughly the ink density of a busy wave.
+    std::vector<uint8_t> vram(VideoConverter::SCREEN_WIDTH * VideoConverter::BYTES_PER_SCANLINE);
+    uint32_t seed = 0x2400;
+    for (uint8_t& byte : vram) {
+        seed = seed * 1664525u + 1013904223u;
+        byte = (seed >> 24) & (seed >> 16);
+    }
+
+    VideoConverter::RowPalette palette;
+    palette.setBands(VideoConverter::RowPalette::classicBands());
+    VideoFrame frame(VideoConverter::SCREEN_WIDTH, VideoConverter::SCREEN_HEIGHT);
+    VideoConverter::convert(vram.data(), palette, frame);
+
+    std::vector<BenchmarkResult> results;
+    for (Filter f : { Filter::None, Filter::Scale2x, Filter::Scale3x, Filter::Scale4x, Filter::XBR }) {
+        PixelScaler scaler(f);
+        const int stride = VideoConverter::SCREEN_WIDTH * scaler.factor();
+        std::vector<uint8_t> out(static_cast<size_t>(stride) * VideoConverter::SCREEN_HEIGHT * scaler.factor());
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            scaler.scale(frame, out.data(), stride, 0, VideoConverter::SCREEN_WIDTH);
+        }
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        results.push_back({ f, backendName(), elapsed.count() / frames });
+    }
+    return results;
+}
@@ -0,0 +1,76 @@
+#ifndef PIXELSCALER_H
+#define PIXELSCALER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "videoconverter.h"
+
+/**
+ * @brief Pixel-art upscaling filters for the converted video frame.
+ *
+ * Each filter maps a source frame onto an 8-bit destination that is factor()
+ * times wider and taller. The kernels are written once against a small vector
+ * abstraction and instantiated for SSE2 and AVX2; the AVX2 build is selected
+ * at runtime when the host supports it, with a scalar path for everything else.
+ */
+class PixelScaler {
+public:
+    enum class Filter {
+        None,    ///< Nearest-neighbour copy, leaves scaling to the painter.
+        Scale2x,
+        Scale3x,
+        Scale4x, ///< Scale2x applied twice.
+        XBR      ///< Edge-directed 2x filter after Hyllian's xBR.
+    };
+
+    explicit PixelScaler(Filter filter = Filter::None);
+
+    void setFilter(Filter filter);
+    Filter filter() const { return currentFilter; }
+
+    /**
+     * @brief Integer scale factor of the current filter.
+     */
+    int factor() const { return factorOf(currentFilter); }
+
+    /**
+     * @brief Scales source columns [firstColumn, lastColumn) into dst.
+     * @param src Source frame.
+     * @param dst Top-left pixel of the destination image.
+     * @param dstStride Bytes per destination row.
+     * @param firstColumn First source column to scale.
+     * @param lastColumn One past the last source column to scale.
+     */
+    void scale(const VideoFrame& src, uint8_t* dst, int dstStride, int firstColumn, int lastColumn);
+
+    static int factorOf(Filter filter);
+    static const char* filterName(Filter filter);
+    static Filter filterFromName(const std::string& name, Filter fallback = Filter::None);
+
+    /**
+     * @brief Result of timing one filter over a fixed number of frames.
+     */
+    struct BenchmarkResult {
+        Filter filter;
+        const char* backend;
+        double microsecondsPerFrame;
+    };
+
+    /**
+     * @brief Times every filter on the active backend over a synthetic video RAM image.
+     * @param frames Number of frames scaled per filter.
+     */
+    static std::vector<BenchmarkResult> benchmark(int frames = 600);
+
+    /**
+     * @brief Name of the kernel set chosen for this host ("avx2", "sse2" or "scalar").
+     */
+    static const char* backendName();
+
+private:
+    Filter currentFilter;
+    VideoFrame intermediate; ///< 2x stage for Scale4x.
+};
+
+#endif // PIXELSCALER_H
@@ -0,0 +1,49 @@
+// AVX2 build of the scaling kernels. CMake compiles this file alone with
+// AVX2 enabled; PixelScaler only calls into it after a runtime CPU check.
+
+#include "pixelscaler_kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2 {
+    using T = __m256i;
+    static constexpr int N = 32;
+
+    static T load(const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void store(uint8_t* p, T v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static T eq(T a, T b) { return _mm256_cmpeq_epi8(a, b); }
+    static T lt(T a, T b) { return _mm256_cmpgt_epi8(b, a); }
+    static T and_(T a, T b) { return _mm256_and_si256(a, b); }
+    static T or_(T a, T b) { return _mm256_or_si256(a, b); }
+    static T andnot(T a, T b) { return _mm256_andnot_si256(a, b); }
+    static T add(T a, T b) { return _mm256_adds_epu8(a, b); }
+    static T avg(T a, T b) { return _mm256_avg_epu8(a, b); }
+    static T max(T a, T b) { return _mm256_max_epu8(a, b); }
+    static T set1(int v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+
+    static void storeInterleaved2(uint8_t* p, T a, T b) {
+        // unpack works per 128-bit lane, so stitch the lanes back in order.
+        const T lo = _mm256_unpacklo_epi8(a, b);
+        const T hi = _mm256_unpackhi_epi8(a, b);
+        store(p, _mm256_permute2x128_si256(lo, hi, 0x20));
+        store(p + N, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+};
+
+} // namespace
+
+const PixelScalerKernels::KernelSet PixelScalerKernels::avx2Kernels = {
+    "avx2",
+    &PixelScalerKernels::scale2x<Avx2>,
+    &PixelScalerKernels::scale3x<Avx2>,
+    &PixelScalerKernels::xbr2x<Avx2>
+};
+
+#else
+
+const PixelScalerKernels::KernelSet PixelScalerKernels::avx2Kernels = { "avx2", nullptr, nullptr, nullptr };
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef PIXELSCALER_KERNELS_H
+#define PIXELSCALER_KERNELS_H
+
+/*
+ * Scaling kernels shared by the SSE2 and AVX2 builds of PixelScaler.
+ *
+ * The SIMD kernels are templates over a vector traits type V that provides:
+ *   T, N                      - vector type and its width in bytes
+ *   load, store               - unaligned 8-bit loads and stores
+ *   eq, lt                    - byte compares returning 0x00/0xff masks
+ *   and_, or_, andnot, add    - bitwise ops (andnot(a, b) == ~a & b), saturating add
+ *   avg, max                  - rounding average, unsigned maximum
+ *   set1                      - broadcast
+ *   storeInterleaved2         - store a0 b0 a1 b1 ... (2N bytes)
+ *
+ * Columns that do not fill a whole vector fall back to the scalar per-pixel
+ * functions, which are also the reference implementation for non-x86 hosts.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include "videoconverter.h"
+
+namespace PixelScalerKernels {
+
+// ---------------------------------------------------------------------------
+// Scalar reference
+// ---------------------------------------------------------------------------
+
+inline void scale2xPixel(const VideoFrame& src, uint8_t* dst, int dstStride, int x, int y) {
+    const uint8_t B = src.row(y - 1)[x];
+    const uint8_t D = src.row(y)[x - 1];
+    const uint8_t E = src.row(y)[x];
+    const uint8_t F = src.row(y)[x + 1];
+    const uint8_t H = src.row(y + 1)[x];
+
+    uint8_t* out0 = dst + (2 * y) * dstStride + 2 * x;
+    uint8_t* out1 = out0 + dstStride;
+    if (B != H && D != F) {
+        out0[0] = D == B ? D : E;
+        out0[1] = B == F ? F : E;
+        out1[0] = D == H ? D : E;
+        out1[1] = H == F ? F : E;
+    } else {
+        out0[0] = out0[1] = out1[0] = out1[1] = E;
+    }
+}
+
+inline void scale3xPixel(const VideoFrame& src, uint8_t* dst, int dstStride, int x, int y) {
+    const uint8_t* up = src.row(y - 1) + x;
+    const uint8_t* mid = src.row(y) + x;
+    const uint8_t* down = src.row(y + 1) + x;
+    const uint8_t A = up[-1], B = up[0], C = up[1];
+    const uint8_t D = mid[-1], E = mid[0], F = mid[1];
+    const uint8_t G = down[-1], H = down[0], I = down[1];
+
+    uint8_t* out0 = dst + (3 * y) * dstStride + 3 * x;
+    uint8_t* out1 = out0 + dstStride;
+    uint8_t* out2 = out1 + dstStride;
+    if (B != H && D != F) {
+        out0[0] = D == B ? D : E;
+        out0[1] = ((D == B && E != C) || (B == F && E != A)) ? B : E;
+        out0[2] = B == F ? F : E;
+        out1[0] = ((D == B && E != G) || (D == H && E != A)) ? D : E;
+        out1[1] = E;
+        out1[2] = ((B == F && E != I) || (H == F && E != C)) ? F : E;
+        out2[0] = D == H ? D : E;
+        out2[1] = ((D == H && E != I) || (H == F && E != G)) ? H : E;
+        out2[2] = H == F ? F : E;
+    } else {
+        for (int i = 0; i < 3; ++i) {
+            out0[i] = out1[i] = out2[i] = E;
+        }
+    }
+}
+
+// Half-way blend of two palette indices: the intensities are averaged and the
+// colour band is taken from the brighter index, since an unlit pixel carries
+// no band of its own.
+inline uint8_t blendIndex(uint8_t a, uint8_t b) {
+    const uint8_t band = std::max(a, b) & VideoConverter::BAND_MASK;
+    const int level = ((a & VideoConverter::LEVEL_MASK) + (b & VideoConverter::LEVEL_MASK) + 1) >> 1;
+    return static_cast<uint8_t>(band | level);
+}
+
+// One output corner of xBR 2x. SU/SV point from the source pixel towards the
+// corner, so the same rule covers all four corners by mirroring the 5x5 window.
+template <int SU, int SV>
+inline uint8_t xbrCornerPixel(const VideoFrame& src, int x, int y) {
+    auto P = [&](int u, int v) { return src.row(y + v * SV)[x + u * SU]; };
+    auto d = [](uint8_t a, uint8_t b) { return a != b ? 1 : 0; };
+
+    const uint8_t E = P(0, 0), F = P(1, 0), H = P(0, 1), I = P(1, 1);
+    if (E == F || E == H) {
+        return E;
+    }
+    const uint8_t B = P(0, -1), C = P(1, -1), D = P(-1, 0), G = P(-1, 1);
+    const uint8_t F4 = P(2, 0), I4 = P(2, 1), H5 = P(0, 2), I5 = P(1, 2);
+
+    const int e = d(E, C) + d(E, G) + d(I, H5) + d(I, F4) + 4 * d(H, F);
+    const int i = d(H, D) + d(H, I5) + d(F, I4) + d(F, B) + 4 * d(E, I);
+    const bool rule = (F != B && H != D) || (E == I && F != I4 && H != I5) || E == G || E == C;
+    if (e < i && rule) {
+        const uint8_t px = d(E, F) <= d(E, H) ? F : H;
+        return blendIndex(E, px);
+    }
+    return E;
+}
+
+inline void xbr2xPixel(const VideoFrame& src, uint8_t* dst, int dstStride, int x, int y) {
+    uint8_t* out0 = dst + (2 * y) * dstStride + 2 * x;
+    uint8_t* out1 = out0 + dstStride;
+    out0[0] = xbrCornerPixel<-1, -1>(src, x, y);
+    out0[1] = xbrCornerPixel<+1, -1>(src, x, y);
+    out1[0] = xbrCornerPixel<-1, +1>(src, x, y);
+    out1[1] = xbrCornerPixel<+1, +1>(src, x, y);
+}
+
+template <void (*Pixel)(const VideoFrame&, uint8_t*, int, int, int)>
+inline void scalarColumns(const VideoFrame& src, uint8_t* dst, int dstStride, int x0, int x1) {
+    for (int y = 0; y < src.height(); ++y) {
+        for (int x = x0; x < x1; ++x) {
+            Pixel(src, dst, dstStride, x, y);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SIMD
+// ---------------------------------------------------------------------------
+
+template <class V>
+inline typename V::T select(typename V::T mask, typename V::T a, typename V::T b) {
+    return V::or_(V::and_(mask, a), V::andnot(mask, b));
+}
+
+template <class V>
+inline typename V::T neq(typename V::T a, typename V::T b) {
+    return V::andnot(V::eq(a, b), V::set1(0xff));
+}
+
+template <class V>
+void scale2x(const VideoFrame& src, uint8_t* dst, int dstStride, int x0, int x1) {
+    using T = typename V::T;
+    for (int y = 0; y < src.height(); ++y) {
+        const uint8_t* up = src.row(y - 1);
+        const uint8_t* mid = src.row(y);
+        const uint8_t* down = src.row(y + 1);
+        uint8_t* out0 = dst + (2 * y) * dstStride;
+        uint8_t* out1 = out0 + dstStride;
+
+        int x = x0;
+        for (; x + V::N <= x1; x += V::N) {
+            const T B = V::load(up + x);
+            const T D = V::load(mid + x - 1);
+            const T E = V::load(mid + x);
+            const T F = V::load(mid + x + 1);
+            const T H = V::load(down + x);
+
+            const T active = V::andnot(V::or_(V::eq(B, H), V::eq(D, F)), V::set1(0xff));
+            const T e0 = select<V>(V::and_(active, V::eq(D, B)), D, E);
+            const T e1 = select<V>(V::and_(active, V::eq(B, F)), F, E);
+            const T e2 = select<V>(V::and_(active, V::eq(D, H)), D, E);
+            const T e3 = select<V>(V::and_(active, V::eq(H, F)), F, E);
+
+            V::storeInterleaved2(out0 + 2 * x, e0, e1);
+            V::storeInterleaved2(out1 + 2 * x, e2, e3);
+        }
+        for (; x < x1; ++x) {
+            scale2xPixel(src, dst, dstStride, x, y);
+        }
+    }
+}
+
+template <class V>
+void scale3x(const VideoFrame& src, uint8_t* dst, int dstStride, int x0, int x1) {
+    using T = typename V::T;
+    alignas(32) uint8_t lanes[9][V::N];
+
+    for (int y = 0; y < src.height(); ++y) {
+        const uint8_t* up = src.row(y - 1);
+        const uint8_t* mid = src.row(y);
+        const uint8_t* down = src.row(y + 1);
+        uint8_t* out[3] = {
+            dst + (3 * y) * dstStride,
+            dst + (3 * y + 1) * dstStride,
+            dst + (3 * y + 2) * dstStride
+        };
+
+        int x = x0;
+        for (; x + V::N <= x1; x += V::N) {
+            const T A = V::load(up + x - 1), B = V::load(up + x), C = V::load(up + x + 1);
+            const T D = V::load(mid + x - 1), E = V::load(mid + x), F = V::load(mid + x + 1);
+            const T G = V::load(down + x - 1), H = V::load(down + x), I = V::load(down + x + 1);
+
+            const T active = V::andnot(V::or_(V::eq(B, H), V::eq(D, F)), V::set1(0xff));
+            const T DB = V::and_(active, V::eq(D, B));
+            const T BF = V::and_(active, V::eq(B, F));
+            const T DH = V::and_(active, V::eq(D, H));
+            const T HF = V::and_(active, V::eq(H, F));
+
+            V::store(lanes[0], select<V>(DB, D, E));
+            V::store(lanes[1], select<V>(V::or_(V::and_(DB, neq<V>(E, C)), V::and_(BF, neq<V>(E, A))), B, E));
+            V::store(lanes[2], select<V>(BF, F, E));
+            V::store(lanes[3], select<V>(V::or_(V::and_(DB, neq<V>(E, G)), V::and_(DH, neq<V>(E, A))), D, E));
+            V::store(lanes[4], E);
+            V::store(lanes[5], select<V>(V::or_(V::and_(BF, neq<V>(E, I)), V::and_(HF, neq<V>(E, C))), F, E));
+            V::store(lanes[6], select<V>(DH, D, E));
+            V::store(lanes[7], select<V>(V::or_(V::and_(DH, neq<V>(E, I)), V::and_(HF, neq<V>(E, G))), H, E));
+            V::store(lanes[8], select<V>(HF, F, E));
+
+            // Three-way interleave has no cheap SSE2 shuffle; the compare work
+            // above dominates, so the final spread is done with scalar stores.
+            for (int r = 0; r < 3; ++r) {
+                uint8_t* o = out[r] + 3 * x;
+                for (int i = 0; i < V::N; ++i) {
+                    o[3 * i] = lanes[3 * r][i];
+                    o[3 * i + 1] = lanes[3 * r + 1][i];
+                    o[3 * i + 2] = lanes[3 * r + 2][i];
+                }
+            }
+        }
+        for (; x < x1; ++x) {
+            scale3xPixel(src, dst, dstStride, x, y);
+        }
+    }
+}
+
+template <class V, int SU, int SV>
+inline typename V::T xbrCorner(const uint8_t* const* rows, int x) {
+    using T = typename V::T;
+    // rows[2] is the current row; rows[2 + v] is v rows below it.
+    auto P = [&](int u, int v) { return V::load(rows[2 + v * SV] + x + u * SU); };
+    const T one = V::set1(1);
+    auto d = [&](T a, T b) { return V::andnot(V::eq(a, b), one); };
+
+    const T E = P(0, 0), F = P(1, 0), H = P(0, 1), I = P(1, 1);
+    const T B = P(0, -1), C = P(1, -1), D = P(-1, 0), G = P(-1, 1);
+    const T F4 = P(2, 0), I4 = P(2, 1), H5 = P(0, 2), I5 = P(1, 2);
+
+    const T dHF = d(H, F), dEI = d(E, I);
+    const T e = V::add(V::add(V::add(d(E, C), d(E, G)), V::add(d(I, H5), d(I, F4))),
+                       V::add(V::add(dHF, dHF), V::add(dHF, dHF)));
+    const T i = V::add(V::add(V::add(d(H, D), d(H, I5)), V::add(d(F, I4), d(F, B))),
+                       V::add(V::add(dEI, dEI), V::add(dEI, dEI)));
+
+    const T ones = V::set1(0xff);
+    const T eqEF = V::eq(E, F), eqEH = V::eq(E, H);
+    const T edge = V::andnot(V::or_(eqEF, eqEH), ones);
+    const T rule = V::or_(
+        V::or_(V::andnot(V::or_(V::eq(F, B), V::eq(H, D)), ones),
+               V::andnot(V::or_(V::eq(F, I4), V::eq(H, I5)), V::eq(E, I))),
+        V::or_(V::eq(E, G), V::eq(E, C)));
+    const T blend = V::and_(V::and_(edge, rule), V::lt(e, i));
+
+    // d(E,F) <= d(E,H) picks F unless E matches F and not H.
+    const T pickH = V::andnot(eqEF, eqEH);
+    const T px = select<V>(pickH, H, F);
+    const T levels = V::set1(VideoConverter::LEVEL_MASK);
+    const T mixed = V::or_(V::andnot(levels, V::max(E, px)), V::avg(V::and_(E, levels), V::and_(px, levels)));
+    return select<V>(blend, mixed, E);
+}
+
+template <class V>
+void xbr2x(const VideoFrame& src, uint8_t* dst, int dstStride, int x0, int x1) {
+    for (int y = 0; y < src.height(); ++y) {
+        const uint8_t* rows[5] = {
+            src.row(y - 2), src.row(y - 1), src.row(y), src.row(y + 1), src.row(y + 2)
+        };
+        uint8_t* out0 = dst + (2 * y) * dstStride;
+        uint8_t* out1 = out0 + dstStride;
+
+        int x = x0;
+        for (; x + V::N <= x1; x += V::N) {
+            V::storeInterleaved2(out0 + 2 * x, xbrCorner<V, -1, -1>(rows, x), xbrCorner<V, +1, -1>(rows, x));
+            V::storeInterleaved2(out1 + 2 * x, xbrCorner<V, -1, +1>(rows, x), xbrCorner<V, +1, +1>(rows, x));
+        }
+        for (; x < x1; ++x) {
+            xbr2xPixel(src, dst, dstStride, x, y);
+        }
+    }
+}
+
+// Column-range kernel entry point shared by every backend.
+using KernelFn = void (*)(const VideoFrame& src, uint8_t* dst, int dstStride, int x0, int x1);
+
+struct KernelSet {
+    const char* name;
+    KernelFn scale2x;
+    KernelFn scale3x;
+    KernelFn xbr2x;
+};
+
+// Defined in pixelscaler_avx2.cpp; null members when the TU was built without AVX2.
+extern const KernelSet avx2Kernels;
+
+} // namespace PixelScalerKernels
+
+#endif // PIXELSCALER_KERNELS_H
@@ -0,0 +1,223 @@
+#include "soundsynth.h"
+#include "../emulator/io_bits.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr float PI = 3.14159265f;
+constexpr float OUTPUT_SCALE = 12000.0f; ///< Full-scale bus level in 16-bit units, leaving headroom for overlaps
+constexpr float GATE_RATE = 0.002f;      ///< Per-sample slew of the UFO and AMP gates, about 10 ms
+
+// Approximate pitches of the four descending fleet steps, in Hz
+constexpr float FLEET_PITCH[4] = { 98.0f, 87.3f, 77.8f, 73.4f };
+
+inline float square(float phase) {
+    return phase < 0.5f ? 1.0f : -1.0f;
+}
+
+inline float wrap(float phase) {
+    return phase >= 1.0f ? phase - 1.0f : phase;
+}
+
+} // namespace
+
+void SoundSynth::LowPass::setCutoff(float hz, int sampleRate) {
+    coefficient = 1.0f - std::exp(-2.0f * PI * hz / sampleRate);
+}
+
+void SoundSynth::Envelope::setTimeConstant(float seconds, int sampleRate) {
+    factor = std::exp(-1.0f / (seconds * sampleRate));
+}
+
+SoundSynth::SoundSynth(int sampleRate)
+    : rate(sampleRate)
+{
+    // Shot: bright noise with a short tail
+    shot.first.setCutoff(3500.0f, rate);
+    shot.second.setCutoff(1800.0f, rate);
+    shot.envelope.setTimeConstant(0.09f, rate);
+    shot.gain = 0.9f;
+
+    // Player explosion: low rumble, long decay
+    playerDie.first.setCutoff(500.0f, rate);
+    playerDie.second.setCutoff(250.0f, rate);
+    playerDie.envelope.setTimeConstant(0.55f, rate);
+    playerDie.gain = 2.2f;
+
+    // Invader explosion: mid-band crack
+    invaderDie.first.setCutoff(1600.0f, rate);
+    invaderDie.second.setCutoff(900.0f, rate);
+    invaderDie.envelope.setTimeConstant(0.12f, rate);
+    invaderDie.gain = 1.4f;
+
+    for (int i = 0; i < 4; ++i) {
+        fleet[i].increment = FLEET_PITCH[i] / rate;
+        fleet[i].filter.setCutoff(400.0f, rate);
+        fleet[i].envelope.setTimeConstant(0.05f, rate);
+        fleet[i].gain = 0.6f;
+    }
+
+    // UFO hit: warbling tone
+    ufoHit.increment = 900.0f / rate;
+    ufoHit.warbleIncrement = 14.0f / rate;
+    ufoHit.warbleDepth = 0.45f;
+    ufoHit.filter.setCutoff(2500.0f, rate);
+    ufoHit.envelope.setTimeConstant(0.35f, rate);
+    ufoHit.gain = 0.5f;
+
+    ufoFilter.setCutoff(1800.0f, rate);
+    reset();
+}
+
+void SoundSynth::reset() {
+    port3 = 0;
+    port5 = 0;
+    lfsr = 1;
+    ufoPhase = 0.0f;
+    ufoSweepPhase = 0.0f;
+    ufoGate = 0.0f;
+    ampGate = 0.0f;
+    ufoFilter.state = 0.0f;
+    for (NoiseBurst* burst : { &shot, &playerDie, &invaderDie }) {
+        burst->first.state = burst->second.state = 0.0f;
+        burst->envelope.level = 0.0f;
+    }
+    for (ToneBurst* burst : { &fleet[0], &fleet[1], &fleet[2], &fleet[3], &ufoHit }) {
+        burst->filter.state = 0.0f;
+        burst->envelope.level = 0.0f;
+    }
+}
+
+void SoundSynth::writePort(uint8_t port, uint8_t value) {
+    if (port == 3) {
+        const uint8_t rising = ~port3 & value;
+        if (rising & SHOTS) {
+            shot.envelope.fire(1.0f);
+        }
+        if (rising & PLAYER_DIE) {
+            playerDie.envelope.fire(1.0f);
+        }
+        if (rising & INVADER_DIE) {
+            invaderDie.envelope.fire(1.0f);
+        }
+        port3 = value; // UFO and AMP_ON are level-sensitive, read while rendering
+    } else if (port == 5) {
+        const uint8_t rising = ~port5 & value;
+        const uint8_t steps[4] = { FLEET1, FLEET2, FLEET3, FLEET4 };
+        for (int i = 0; i < 4; ++i) {
+            if (rising & steps[i]) {
+                fleet[i].phase = 0.0f;
+                fleet[i].envelope.fire(1.0f);
+            }
+        }
+        if (rising & UFO_HIT) {
+            ufoHit.warblePhase = 0.0f;
+            ufoHit.envelope.fire(1.0f);
+        }
+        port5 = value;
+    }
+}
+
+void SoundSynth::renderUfo(int frames) {
+    const float target = (port3 & UFO) ? 1.0f : 0.0f;
+    if (target == 0.0f && ufoGate < 1.0e-4f) {
+        ufoGate = 0.0f;
+        return;
+    }
+
+    const float sweepIncrement = 4.0f / rate;
+    for (int i = 0; i < frames; ++i) {
+        ufoGate += GATE_RATE * (target - ufoGate);
+        ufoSweepPhase = wrap(ufoSweepPhase + sweepIncrement);
+        const float triangle = 4.0f * std::fabs(ufoSweepPhase - 0.5f) - 1.0f;
+        ufoPhase = wrap(ufoPhase + (700.0f + 200.0f * triangle) / rate);
+        bus[i] += 0.35f * ufoGate * ufoFilter.process(square(ufoPhase));
+    }
+}
+
+void SoundSynth::renderNoiseBurst(NoiseBurst& burst, int frames) {
+    if (!burst.envelope.active()) {
+        return;
+    }
+    for (int i = 0; i < frames; ++i) {
+        const float filtered = burst.second.process(burst.first.process(noiseBlock[i]));
+        bus[i] += burst.gain * burst.envelope.level * filtered;
+        burst.envelope.level *= burst.envelope.factor;
+    }
+}
+
+void SoundSynth::renderToneBurst(ToneBurst& burst, int frames) {
+    if (!burst.envelope.active()) {
+        return;
+    }
+    for (int i = 0; i < frames; ++i) {
+        burst.warblePhase = wrap(burst.warblePhase + burst.warbleIncrement);
+        const float pitch = 1.0f + burst.warbleDepth * square(burst.warblePhase);
+        burst.phase = wrap(burst.phase + burst.increment * pitch);
+        bus[i] += burst.gain * burst.envelope.level * burst.filter.process(square(burst.phase));
+        burst.envelope.level *= burst.envelope.factor;
+    }
+}
+
+void SoundSynth::renderBlock(int frames) {
+    std::fill(bus, bus + frames, 0.0f);
+
+    // One noise source feeds all three noise circuits, as on the board
+    if (shot.envelope.active() || playerDie.envelope.active() || invaderDie.envelope.active()) {
+        for (int i = 0; i < frames; ++i) {
+            // 17-bit maximal-length LFSR, taps 17 and 14
+            lfsr = (lfsr >> 1) ^ ((0u - (lfsr & 1u)) & 0x12000u);
+            noiseBlock[i] = (lfsr & 1u) ? 1.0f : -1.0f;
+        }
+    }
+
+    renderUfo(frames);
+    renderNoiseBurst(shot, frames);
+    renderNoiseBurst(playerDie, frames);
+    renderNoiseBurst(invaderDie, frames);
+    for (ToneBurst& step : fleet) {
+        renderToneBurst(step, frames);
+    }
+    renderToneBurst(ufoHit, frames);
+}
+
+void SoundSynth::render(int16_t* out, int frames) {
+    const float ampTarget = (port3 & AMP_ON) ? 1.0f : 0.0f;
+
+    for (int done = 0; done < frames; done += BLOCK_FRAMES) {
+        const int count = std::min(BLOCK_FRAMES, frames - done);
+        renderBlock(count);
+
+        for (int i = 0; i < count; ++i) {
+            ampGate += GATE_RATE * (ampTarget - ampGate);
+            const float sample = out[done + i] + OUTPUT_SCALE * ampGate * bus[i];
+            out[done + i] = static_cast<int16_t>(std::clamp(sample, -32768.0f, 32767.0f));
+        }
+    }
+}
+
+double SoundSynth::benchmark(int seconds) {
+    constexpr int SAMPLE_RATE = 48000;
+    constexpr int PERIOD = SAMPLE_RATE / 100;
+    SoundSynth synth(SAMPLE_RATE);
+    std::vector<int16_t> out(PERIOD);
+
+    // Retrigger every circuit ten times a second with the UFO running throughout
+    const int periods = seconds * 100;
+    const auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < periods; ++p) {
+        if (p % 10 == 0) {
+            synth.writePort(3, AMP_ON | UFO);
+            synth.writePort(5, 0);
+            synth.writePort(3, AMP_ON | UFO | SHOTS | PLAYER_DIE | INVADER_DIE);
+            synth.writePort(5, FLEET1 | FLEET2 | FLEET3 | FLEET4 | UFO_HIT);
+        }
+        std::fill(out.begin(), out.end(), 0);
+        synth.render(out.data(), PERIOD);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return 100.0 * elapsed.count() / seconds;
+}
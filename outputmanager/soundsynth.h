@@ -0,0 +1,111 @@
+#ifndef SOUNDSYNTH_H
+#define SOUNDSYNTH_H
+
+#include <cstdint>
+
+/**
+ * @brief Models the cabinet's discrete sound circuits instead of playing samples.
+ *
+ * Driven directly by the port 3 and port 5 latches: rising bits fire the
+ * one-shot circuits and the UFO oscillator runs for as long as its bit is
+ * held, so it loops without gaps. Output is muted while the AMP_ON bit is
+ * clear, as on the real board.
+ *
+ * Each circuit is a small chain of oscillators, a shared noise generator,
+ * one-pole filters and an RC-style exponential envelope, rendered in fixed
+ * blocks into a float bus. The parameters are approximations of the board's
+ * timing components, not a component-level simulation.
+ */
+class SoundSynth {
+public:
+    static constexpr int BLOCK_FRAMES = 64; ///< Samples processed per pipeline stage.
+
+    explicit SoundSynth(int sampleRate);
+
+    /**
+     * @brief Applies a write to sound port 3 or 5.
+     */
+    void writePort(uint8_t port, uint8_t value);
+
+    /**
+     * @brief Adds the next frames samples of all circuits to out, saturating.
+     */
+    void render(int16_t* out, int frames);
+
+    /**
+     * @brief Silences every circuit and clears the port latches.
+     */
+    void reset();
+
+    /**
+     * @brief Share of one core needed to run in real time with every circuit busy, in percent.
+     * @param seconds Length of audio rendered for the measurement.
+     */
+    static double benchmark(int seconds = 10);
+
+private:
+    // One-pole low-pass filter
+    struct LowPass {
+        float coefficient = 0.0f;
+        float state = 0.0f;
+        void setCutoff(float hz, int sampleRate);
+        float process(float x) { state += coefficient * (x - state); return state; }
+    };
+
+    // Exponential discharge of a capacitor, restarted by a trigger
+    struct Envelope {
+        float level = 0.0f;
+        float factor = 0.0f;
+        void setTimeConstant(float seconds, int sampleRate);
+        void fire(float peak) { level = peak; }
+        bool active() const { return level > 1.0e-4f; }
+    };
+
+    // A noise-driven one-shot (shot, explosions)
+    struct NoiseBurst {
+        LowPass first;
+        LowPass second;
+        Envelope envelope;
+        float gain = 1.0f;
+    };
+
+    // A tone one-shot (fleet steps, UFO hit)
+    struct ToneBurst {
+        float phase = 0.0f;
+        float increment = 0.0f;
+        float warblePhase = 0.0f;
+        float warbleIncrement = 0.0f;
+        float warbleDepth = 0.0f;
+        LowPass filter;
+        Envelope envelope;
+        float gain = 1.0f;
+    };
+
+    int rate;
+    uint8_t port3;
+    uint8_t port5;
+
+    uint32_t lfsr; ///< Shared white-noise generator
+    float noiseBlock[BLOCK_FRAMES];
+    float bus[BLOCK_FRAMES];
+
+    // UFO: square-wave oscillator swept by a slow triangle
+    float ufoPhase;
+    float ufoSweepPhase;
+    float ufoGate; ///< Smoothed on/off so the loop starts and stops without clicks
+    LowPass ufoFilter;
+
+    NoiseBurst shot;
+    NoiseBurst playerDie;
+    NoiseBurst invaderDie;
+    ToneBurst fleet[4];
+    ToneBurst ufoHit;
+    float ampGate; ///< Smoothed AMP_ON
+
+    void renderBlock(int frames);
+    void renderUfo(int frames);
+    void renderNoiseBurst(NoiseBurst& burst, int frames);
+    void renderToneBurst(ToneBurst& burst, int frames);
+};
+
+#endif // SOUNDSYNTH_H
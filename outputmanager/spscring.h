@@ -0,0 +1,125 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer and one consumer thread.
+ *
+ * push() is only called by the producer and pop() only by the consumer. Neither
+ * allocates, locks or waits, so both are safe on the emulation hot path and in
+ * the audio callback. Capacity must be a power of two; one slot is never used
+ * so that full and empty can be told apart.
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /**
+     * @brief Appends an item. Producer thread only.
+     * @return False if the ring is full and the item was dropped.
+     */
+    bool push(const T& item) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t next = (h + 1) & MASK;
+        if (next == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        items[h] = item;
+        head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item. Consumer thread only.
+     * @return False if the ring was empty.
+     */
+    bool pop(T& item) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[t];
+        tail.store((t + 1) & MASK, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Looks at the oldest item without removing it. Consumer thread only.
+     * @return Null if the ring is empty.
+     */
+    const T* peek() const {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        return t == head.load(std::memory_order_acquire) ? nullptr : &items[t];
+    }
+
+    /**
+     * @brief Appends up to count items. Producer thread only.
+     * @return Number of items written; fewer than count if the ring filled up.
+     */
+    size_t write(const T* data, size_t count) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t free = (tail.load(std::memory_order_acquire) - h - 1) & MASK;
+        const size_t n = count < free ? count : free;
+        const size_t first = n < Capacity - h ? n : Capacity - h;
+        std::copy(data, data + first, items + h);
+        std::copy(data + first, data + n, items);
+        head.store((h + n) & MASK, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief Removes up to count of the oldest items. Consumer thread only.
+     * @param data Destination, or null to discard the items.
+     * @return Number of items read.
+     */
+    size_t read(T* data, size_t count) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t used = (head.load(std::memory_order_acquire) - t) & MASK;
+        const size_t n = count < used ? count : used;
+        if (data) {
+            const size_t first = n < Capacity - t ? n : Capacity - t;
+            std::copy(items + t, items + t + first, data);
+            std::copy(items, items + (n - first), data + first);
+        }
+        tail.store((t + n) & MASK, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief Items that can be written without dropping any. Producer thread only.
+     */
+    size_t writeAvailable() const {
+        return (tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed) - 1) & MASK;
+    }
+
+    /**
+     * @brief Items waiting to be read. Consumer thread only.
+     */
+    size_t readAvailable() const {
+        return (head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed)) & MASK;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    // Keep the indices on separate cache lines so the two threads do not
+    // invalidate each other's line on every operation.
+    alignas(64) std::atomic<size_t> head; ///< Next slot to write (producer).
+    alignas(64) std::atomic<size_t> tail; ///< Next slot to read (consumer).
+    alignas(64) T items[Capacity];
+};
+
+#endif // SPSCRING_H
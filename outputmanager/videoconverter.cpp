@@ -0,0 +1,141 @@
+#include "videoconverter.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+VideoFrame::VideoFrame(int width, int height)
+    : frameWidth(width),
+    frameHeight(height),
+    frameStride(width + 2 * BORDER_COLS),
+    storage(static_cast<size_t>(frameStride) * (height + 2 * BORDER_ROWS), 0)
+{
+}
+
+void VideoFrame::clear() {
+    std::fill(storage.begin(), storage.end(), 0);
+}
+
+namespace {
+
+// Byte c of expandTable[m] is 0xff when bit c of m is set, so eight
+// horizontally adjacent pixels are masked and written with one 64-bit store.
+const std::array<uint64_t, 256> expandTable = []() {
+    std::array<uint64_t, 256> table{};
+    for (int m = 0; m < 256; ++m) {
+        uint64_t value = 0;
+        for (int c = 0; c < 8; ++c) {
+            if (m & (1 << c)) {
+                value |= uint64_t(0xff) << (8 * c);
+            }
+        }
+        table[m] = value;
+    }
+    return table;
+}();
+
+// Transposes an 8x8 bit matrix: on return, bit c of byte j holds what was
+// bit j of byte c (Hacker's Delight, section 7-3).
+inline uint64_t transpose8x8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+// Converts a block of eight whole columns starting at column x.
+void convertBlock(const uint8_t* vram, const VideoConverter::RowPalette& palette, VideoFrame& frame, int x) {
+    const uint8_t* scanline = vram + x * VideoConverter::BYTES_PER_SCANLINE;
+
+    for (int b = 0; b < VideoConverter::BYTES_PER_SCANLINE; ++b) {
+        uint64_t gathered = 0;
+        for (int c = 0; c < 8; ++c) {
+            gathered |= uint64_t(scanline[c * VideoConverter::BYTES_PER_SCANLINE + b]) << (8 * c);
+        }
+        const uint64_t rows = transpose8x8(gathered);
+
+        // Bit j of byte b is row 255 - (8b + j); the screen is stored bottom-up.
+        const int bottom = VideoConverter::SCREEN_HEIGHT - 1 - b * 8;
+        for (int j = 0; j < 8; ++j) {
+            const int y = bottom - j;
+            const uint64_t lit = palette.litIndex(y) * 0x0101010101010101ULL;
+            const uint64_t pixels = expandTable[(rows >> (8 * j)) & 0xff] & lit;
+            std::memcpy(frame.row(y) + x, &pixels, sizeof(pixels));
+        }
+    }
+}
+
+// Converts a single column; used for ranges that are not multiples of eight.
+void convertColumn(const uint8_t* vram, const VideoConverter::RowPalette& palette, VideoFrame& frame, int x) {
+    const uint8_t* scanline = vram + x * VideoConverter::BYTES_PER_SCANLINE;
+    for (int y = 0; y < VideoConverter::SCREEN_HEIGHT; ++y) {
+        const int bit = VideoConverter::SCREEN_HEIGHT - 1 - y;
+        const bool on = (scanline[bit / 8] >> (bit % 8)) & 1;
+        frame.row(y)[x] = on ? palette.litIndex(y) : VideoConverter::PIXEL_OFF;
+    }
+}
+
+} // namespace
+
+VideoConverter::RowPalette::RowPalette() {
+    setBands({});
+}
+
+void VideoConverter::RowPalette::setBands(const std::vector<OverlayBand>& bands) {
+    uint32_t bandColours[MAX_BANDS] = { 0xffffff };
+    std::fill(rowIndex, rowIndex + SCREEN_HEIGHT, paletteIndex(0, MAX_LEVEL));
+
+    int band = 1;
+    for (const OverlayBand& overlay : bands) {
+        if (band >= MAX_BANDS) {
+            break;
+        }
+        const int first = std::max(overlay.firstRow, 0);
+        const int last = std::min(overlay.lastRow, SCREEN_HEIGHT - 1);
+        if (first > last) {
+            continue;
+        }
+        bandColours[band] = overlay.rgb & 0xffffff;
+        std::fill(rowIndex + first, rowIndex + last + 1, paletteIndex(band, MAX_LEVEL));
+        ++band;
+    }
+
+    colours.assign(256, 0xff000000);
+    for (int b = 0; b < band; ++b) {
+        for (int level = 0; level <= MAX_LEVEL; ++level) {
+            uint32_t rgb = 0xff000000;
+            for (int shift = 0; shift <= 16; shift += 8) {
+                const uint32_t channel = (bandColours[b] >> shift) & 0xff;
+                rgb |= (channel * level / MAX_LEVEL) << shift;
+            }
+            colours[paletteIndex(b, level)] = rgb;
+        }
+    }
+}
+
+std::vector<VideoConverter::OverlayBand> VideoConverter::RowPalette::classicBands() {
+    // Red strip behind the flying saucer, green strip over the bases and cannon.
+    return {
+        { 32, 63, 0xff2020 },
+        { 184, 239, 0x20ff20 }
+    };
+}
+
+void VideoConverter::convertColumns(const uint8_t* vram, const RowPalette& palette, VideoFrame& frame, int firstColumn, int lastColumn) {
+    firstColumn = std::max(firstColumn, 0);
+    lastColumn = std::min(lastColumn, SCREEN_WIDTH);
+
+    int x = firstColumn;
+    for (; x < lastColumn && (x & 7); ++x) {
+        convertColumn(vram, palette, frame, x);
+    }
+    for (; x + 8 <= lastColumn; x += 8) {
+        convertBlock(vram, palette, frame, x);
+    }
+    for (; x < lastColumn; ++x) {
+        convertColumn(vram, palette, frame, x);
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef VIDEOCONVERTER_H
+#define VIDEOCONVERTER_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief An 8-bit-per-pixel frame surrounded by a black border.
+ *
+ * The border lets the scaling kernels read the neighbours of edge pixels
+ * (and run full SIMD widths past the last column) without bounds checks.
+ */
+class VideoFrame {
+public:
+    static constexpr int BORDER_COLS = 32; ///< Padding on the left and right of each row.
+    static constexpr int BORDER_ROWS = 2;  ///< Padding above the first and below the last row.
+
+    VideoFrame(int width, int height);
+
+    int width() const { return frameWidth; }
+    int height() const { return frameHeight; }
+    int stride() const { return frameStride; }
+
+    uint8_t* row(int y) { return storage.data() + (y + BORDER_ROWS) * frameStride + BORDER_COLS; }
+    const uint8_t* row(int y) const { return storage.data() + (y + BORDER_ROWS) * frameStride + BORDER_COLS; }
+
+    /**
+     * @brief Clears the frame, border included, to black.
+     */
+    void clear();
+
+private:
+    int frameWidth;
+    int frameHeight;
+    int frameStride;
+    std::vector<uint8_t> storage;
+};
+
+/**
+ * @brief Converts the Space Invaders 1bpp video RAM into an upright 8-bit frame.
+ *
+ * Video RAM is stored one scanline (displayed column) after another, 32 bytes
+ * per scanline, starting at the bottom of the rotated screen. The converter
+ * transposes it in 8x8 pixel blocks so each output row is written contiguously.
+ */
+namespace VideoConverter {
+
+constexpr int SCREEN_WIDTH = 224;
+constexpr int SCREEN_HEIGHT = 256;
+constexpr int BYTES_PER_SCANLINE = SCREEN_HEIGHT / 8;
+
+/*
+ * Frames hold palette indices rather than colours. The top three bits pick a
+ * colour band and the low five bits an intensity, so overlays, afterglow and
+ * the blending filters all stay within one byte per pixel and the colour is
+ * only resolved by the QImage colour table when the frame is drawn.
+ */
+constexpr int LEVEL_BITS = 5;
+constexpr int MAX_LEVEL = (1 << LEVEL_BITS) - 1;
+constexpr int MAX_BANDS = 256 >> LEVEL_BITS;
+constexpr uint8_t LEVEL_MASK = MAX_LEVEL;
+constexpr uint8_t BAND_MASK = static_cast<uint8_t>(~LEVEL_MASK);
+
+constexpr uint8_t PIXEL_OFF = 0x00;
+
+inline uint8_t paletteIndex(int band, int level) {
+    return static_cast<uint8_t>((band << LEVEL_BITS) | level);
+}
+
+/**
+ * @brief A horizontal strip of the screen tinted by a coloured gel.
+ */
+struct OverlayBand {
+    int firstRow;  ///< First displayed row covered by the gel.
+    int lastRow;   ///< Last displayed row covered by the gel (inclusive).
+    uint32_t rgb;  ///< Gel colour as 0xRRGGBB.
+};
+
+/**
+ * @brief Per-row palette used by the conversion kernel.
+ *
+ * Band 0 is the uncovered (white) screen; each OverlayBand takes the next
+ * band index. Lit pixels in row y are written as litIndex(y), so the overlay
+ * costs nothing beyond the conversion itself.
+ */
+class RowPalette {
+public:
+    RowPalette();
+
+    /**
+     * @brief Replaces the overlay; bands past MAX_BANDS - 1 are ignored.
+     */
+    void setBands(const std::vector<OverlayBand>& bands);
+
+    /**
+     * @brief The gel layout of the original upright cabinet.
+     */
+    static std::vector<OverlayBand> classicBands();
+
+    uint8_t litIndex(int row) const { return rowIndex[row]; }
+    const uint8_t* litIndices() const { return rowIndex; }
+
+    /**
+     * @brief The 256-entry colour table (0xFFRRGGBB) matching the indices.
+     */
+    const std::vector<uint32_t>& colourTable() const { return colours; }
+
+private:
+    uint8_t rowIndex[SCREEN_HEIGHT];
+    std::vector<uint32_t> colours;
+};
+
+/**
+ * @brief Converts displayed columns [firstColumn, lastColumn) of video RAM into a frame.
+ * @param vram Start of video RAM (0x2400 in the machine's address space).
+ * @param palette Per-row palette index for lit pixels.
+ * @param frame Destination frame, SCREEN_WIDTH x SCREEN_HEIGHT.
+ * @param firstColumn First column to convert.
+ * @param lastColumn One past the last column to convert.
+ */
+void convertColumns(const uint8_t* vram, const RowPalette& palette, VideoFrame& frame, int firstColumn, int lastColumn);
+
+/**
+ * @brief Converts the whole screen.
+ */
+inline void convert(const uint8_t* vram, const RowPalette& palette, VideoFrame& frame) {
+    convertColumns(vram, palette, frame, 0, SCREEN_WIDTH);
+}
+
+} // namespace VideoConverter
+
+#endif // VIDEOCONVERTER_H
@@ -0,0 +1,94 @@
+#include "wavfile.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+uint16_t readU16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t readU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+           | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+} // namespace
+
+bool WavFile::decode(const uint8_t* data, size_t size, Pcm& out) {
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    int format = 0;
+    int bitsPerSample = 0;
+    const uint8_t* samples = nullptr;
+    size_t sampleBytes = 0;
+
+    // Walk the chunk list; chunks are padded to an even length.
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const uint8_t* chunk = data + offset;
+        const size_t chunkSize = readU32(chunk + 4);
+        const size_t available = std::min(chunkSize, size - offset - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            format = readU16(chunk + 8);
+            out.channels = readU16(chunk + 10);
+            out.sampleRate = static_cast<int>(readU32(chunk + 12));
+            bitsPerSample = readU16(chunk + 22);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            samples = chunk + 8;
+            sampleBytes = available;
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if (format != 1 || !samples || out.channels < 1 || out.sampleRate <= 0) {
+        return false;
+    }
+
+    if (bitsPerSample == 16) {
+        out.samples.resize(sampleBytes / 2);
+        for (size_t i = 0; i < out.samples.size(); ++i) {
+            out.samples[i] = static_cast<int16_t>(readU16(samples + 2 * i));
+        }
+    } else if (bitsPerSample == 8) {
+        out.samples.resize(sampleBytes);
+        for (size_t i = 0; i < sampleBytes; ++i) {
+            out.samples[i] = static_cast<int16_t>((samples[i] - 128) << 8);
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::vector<int16_t> WavFile::toMono(const Pcm& pcm, int outputRate) {
+    const size_t frames = pcm.channels > 0 ? pcm.samples.size() / pcm.channels : 0;
+    std::vector<int32_t> mono(frames);
+    for (size_t i = 0; i < frames; ++i) {
+        int32_t sum = 0;
+        for (int c = 0; c < pcm.channels; ++c) {
+            sum += pcm.samples[i * pcm.channels + c];
+        }
+        mono[i] = sum / pcm.channels;
+    }
+
+    if (frames == 0 || pcm.sampleRate == outputRate) {
+        return std::vector<int16_t>(mono.begin(), mono.end());
+    }
+
+    const size_t outFrames = static_cast<size_t>(static_cast<uint64_t>(frames) * outputRate / pcm.sampleRate);
+    std::vector<int16_t> resampled(outFrames);
+    const double step = static_cast<double>(pcm.sampleRate) / outputRate;
+    for (size_t i = 0; i < outFrames; ++i) {
+        const double position = i * step;
+        const size_t index = static_cast<size_t>(position);
+        const double fraction = position - index;
+        const int32_t a = mono[index];
+        const int32_t b = mono[std::min(index + 1, frames - 1)];
+        resampled[i] = static_cast<int16_t>(a + (b - a) * fraction);
+    }
+    return resampled;
+}
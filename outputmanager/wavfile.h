@@ -0,0 +1,45 @@
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Minimal RIFF/WAVE reader for the sound effects.
+ *
+ * Only uncompressed PCM (8-bit unsigned or 16-bit signed) is supported,
+ * which is all the cabinet samples use. No Qt types, so the mixer core
+ * can decode without touching the multimedia stack.
+ */
+namespace WavFile {
+
+/**
+ * @brief Decoded PCM, interleaved 16-bit samples.
+ */
+struct Pcm {
+    int sampleRate = 0;
+    int channels = 0;
+    std::vector<int16_t> samples;
+};
+
+/**
+ * @brief Parses a WAV file held in memory.
+ * @param data Start of the file.
+ * @param size File size in bytes.
+ * @param out Receives the decoded samples.
+ * @return False if the file is not PCM WAV or is truncated.
+ */
+bool decode(const uint8_t* data, size_t size, Pcm& out);
+
+/**
+ * @brief Mixes the PCM down to mono and resamples it to outputRate.
+ *
+ * Linear interpolation is plenty for 11 kHz effect samples; this runs
+ * once at load time, never in the audio callback.
+ */
+std::vector<int16_t> toMono(const Pcm& pcm, int outputRate);
+
+} // namespace WavFile
+
+#endif // WAVFILE_H
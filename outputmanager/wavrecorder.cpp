@@ -0,0 +1,119 @@
+#include "wavrecorder.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+constexpr size_t HEADER_BYTES = 44;
+constexpr size_t DRAIN_CHUNK = 4096;
+
+void putU16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void putU32(uint8_t* p, uint32_t value) {
+    putU16(p, static_cast<uint16_t>(value));
+    putU16(p + 2, static_cast<uint16_t>(value >> 16));
+}
+
+} // namespace
+
+WavRecorder::WavRecorder()
+    : file(nullptr),
+    rate(0),
+    dataBytes(0),
+    fixedUpBytes(0),
+    running(false),
+    dropped(0)
+{
+}
+
+WavRecorder::~WavRecorder() {
+    stop();
+}
+
+bool WavRecorder::start(const std::string& path, int sampleRate) {
+    stop();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    rate = sampleRate;
+    dataBytes = 0;
+    fixedUpBytes = 0;
+    dropped.store(0, std::memory_order_relaxed);
+    ring.read(nullptr, ring.readAvailable()); // Anything left from a previous recording
+    writeHeader();
+
+    running.store(true, std::memory_order_release);
+    writer = std::thread(&WavRecorder::writerLoop, this);
+    return true;
+}
+
+void WavRecorder::stop() {
+    if (!running.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    writer.join();
+    drain();
+    writeHeader();
+    std::fclose(file);
+    file = nullptr;
+}
+
+void WavRecorder::write(const int16_t* samples, size_t count) {
+    if (!running.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const size_t written = ring.write(samples, count);
+    if (written < count) {
+        dropped.fetch_add(count - written, std::memory_order_relaxed);
+    }
+}
+
+void WavRecorder::writerLoop() {
+    const uint64_t fixupBytes = static_cast<uint64_t>(rate) * sizeof(int16_t) * HEADER_FIXUP_SECONDS;
+    while (running.load(std::memory_order_acquire)) {
+        drain();
+        if (dataBytes - fixedUpBytes >= fixupBytes) {
+            writeHeader();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_INTERVAL_MS));
+    }
+}
+
+void WavRecorder::drain() {
+    int16_t chunk[DRAIN_CHUNK];
+    uint8_t bytes[DRAIN_CHUNK * sizeof(int16_t)];
+    while (const size_t count = ring.read(chunk, DRAIN_CHUNK)) {
+        // WAV is little-endian whatever the host is
+        for (size_t i = 0; i < count; ++i) {
+            putU16(bytes + 2 * i, static_cast<uint16_t>(chunk[i]));
+        }
+        dataBytes += std::fwrite(bytes, 1, count * sizeof(int16_t), file);
+    }
+}
+
+void WavRecorder::writeHeader() {
+    // Sizes are 32-bit; past 4 GiB (about 12 hours) the header just saturates
+    const uint32_t dataSize = static_cast<uint32_t>(std::min<uint64_t>(dataBytes, UINT32_MAX - HEADER_BYTES));
+
+    uint8_t header[HEADER_BYTES] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+                                     'f', 'm', 't', ' ', 16, 0, 0, 0 };
+    putU32(header + 4, static_cast<uint32_t>(HEADER_BYTES - 8) + dataSize);
+    putU16(header + 20, 1);                                           // PCM
+    putU16(header + 22, 1);                                           // Mono
+    putU32(header + 24, static_cast<uint32_t>(rate));
+    putU32(header + 28, static_cast<uint32_t>(rate) * sizeof(int16_t)); // Byte rate
+    putU16(header + 32, sizeof(int16_t));                             // Block align
+    putU16(header + 34, 16);                                          // Bits per sample
+    header[36] = 'd'; header[37] = 'a'; header[38] = 't'; header[39] = 'a';
+    putU32(header + 40, dataSize);
+
+    std::fseek(file, 0, SEEK_SET);
+    std::fwrite(header, 1, HEADER_BYTES, file);
+    std::fseek(file, 0, SEEK_END);
+    std::fflush(file);
+    fixedUpBytes = dataBytes;
+}
@@ -0,0 +1,76 @@
+#ifndef WAVRECORDER_H
+#define WAVRECORDER_H
+
+#include "spscring.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Records the mixed output to a 16-bit mono PCM WAV file.
+ *
+ * The audio thread hands every rendered block to write(), which only copies
+ * it onto a lock-free ring and never waits; if the disk falls behind far
+ * enough to fill the ring, samples are dropped and counted. A background
+ * thread drains the ring to the file and rewrites the header sizes about
+ * once a second, so a session that ends abruptly still leaves a playable
+ * file up to the last fix-up.
+ */
+class WavRecorder {
+public:
+    static constexpr size_t RING_SAMPLES = 1 << 17;  ///< About 2.7 s at 48 kHz
+    static constexpr int WRITER_INTERVAL_MS = 20;    ///< Writer thread sleep between drains
+    static constexpr int HEADER_FIXUP_SECONDS = 1;   ///< How often the header sizes are brought up to date
+
+    WavRecorder();
+    ~WavRecorder();
+
+    WavRecorder(const WavRecorder&) = delete;
+    WavRecorder& operator=(const WavRecorder&) = delete;
+
+    /**
+     * @brief Creates the file and starts the writer thread.
+     * @return False if the file could not be created.
+     */
+    bool start(const std::string& path, int sampleRate);
+
+    /**
+     * @brief Writes out everything queued, finalizes the header and closes the file.
+     */
+    void stop();
+
+    bool isRecording() const { return running.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Queues rendered samples. Audio thread only; never blocks.
+     */
+    void write(const int16_t* samples, size_t count);
+
+    /**
+     * @brief Samples that can be queued without dropping any. Audio thread only.
+     */
+    size_t space() const { return ring.writeAvailable(); }
+
+    /**
+     * @brief Samples lost because the ring was full since start().
+     */
+    uint64_t droppedSamples() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    SpscRing<int16_t, RING_SAMPLES> ring;
+    std::FILE* file;
+    int rate;
+    uint64_t dataBytes;           ///< Sample bytes written so far (writer thread)
+    uint64_t fixedUpBytes;        ///< dataBytes at the last header fix-up
+    std::atomic<bool> running;
+    std::atomic<uint64_t> dropped;
+    std::thread writer;
+
+    void writerLoop();
+    void drain();
+    void writeHeader();
+};
+
+#endif // WAVRECORDER_H
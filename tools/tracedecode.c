@@ -0,0 +1,83 @@
+/*
+ * Prints an instruction trace written by the emulator (see diagnostics/instructiontrace.h)
+ * in the disassembler's format, one instruction per line with the registers it saw.
+ *
+ * Usage: tracedecode <trace file> [last N instructions]
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../diagnostics/tracerecord.h"
+#include "../disassembler/disassembler.h"
+
+// The disassembler prints through qdebug_log; outside Qt that is plain stdout
+void qdebug_log(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trace file> [last N instructions]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    trace_file_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s is not an instruction trace\n", argv[1]);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    if (header.version != TRACE_VERSION || header.record_size != sizeof(trace_record)
+        || header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0) {
+        fprintf(stderr, "%s: unsupported trace version %u\n", argv[1], header.version);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    // Oldest record still in the ring, then optionally only the last N
+    uint64_t first = header.written > header.capacity ? header.written - header.capacity : 0;
+    if (argc > 2) {
+        uint64_t last = strtoull(argv[2], NULL, 10);
+        if (header.written - first > last) {
+            first = header.written - last;
+        }
+    }
+    fprintf(stderr, "%llu instructions recorded, showing %llu\n",
+            (unsigned long long)header.written, (unsigned long long)(header.written - first));
+
+    // disassemble_opcode reads the instruction from a memory image at pc
+    static unsigned char memory[0x10000 + 2];
+    for (uint64_t i = first; i < header.written; ++i) {
+        trace_record record;
+        long offset = (long)(sizeof(header) + (i & (header.capacity - 1)) * sizeof(record));
+        if (fseek(file, offset, SEEK_SET) != 0 || fread(&record, sizeof(record), 1, file) != 1) {
+            fprintf(stderr, "%s is truncated at instruction %llu\n", argv[1], (unsigned long long)i);
+            fclose(file);
+            return EXIT_FAILURE;
+        }
+
+        memcpy(&memory[record.pc], record.opcode, sizeof(record.opcode));
+        printf("%12llu  ", (unsigned long long)record.cycle);
+        disassemble_opcode(memory, record.pc);
+        printf("\tA $%02x B $%02x C $%02x D $%02x E $%02x H $%02x L $%02x SP %04x Flags: %c%c%c%c%c%c\n",
+               record.a, record.b, record.c, record.d, record.e, record.h, record.l, record.sp,
+               record.flags & TRACE_FLAG_Z ? 'Z' : '.', record.flags & TRACE_FLAG_S ? 'S' : '.',
+               record.flags & TRACE_FLAG_P ? 'P' : '.', record.flags & TRACE_FLAG_CY ? 'C' : '.',
+               record.flags & TRACE_FLAG_AC ? 'A' : '.', record.flags & TRACE_FLAG_IE ? 'I' : '.');
+    }
+
+    fclose(file);
+    return EXIT_SUCCESS;
+}
@@ -28,7 +28,9 @@
 #include "settings.h"
 #include "../inputmanager/keymap.h"
 #include "../outputmanager/outputManager.h"
-#include "../inputmanager/romassembler.h"
+#include "../diagnostics/startuptimeline.h"
+#include "../diagnostics/chrometrace.h"
+#include "../diagnostics/threadcpu.h"
 
 #include <QDebug>
 #include <QFile>
@@ -38,6 +40,8 @@
 #include <QKeySequence>
 #include <QTimer>
 #include <QResizeEvent>
+#include <QHideEvent>
+#include <QShowEvent>
 #include <QPushButton>
 #include <QShortcut>
 
@@ -47,6 +51,11 @@ void MainWindow::startAudioMixer()
     audioMixerThread = new QThread(this);
     audioMixer->moveToThread(audioMixerThread);
     audioMixerThread->start();
+    QMetaObject::invokeMethod(audioMixer, []() {
+        ChromeTrace::setThreadName("audio");
+        ThreadCpu::registerCurrentThread("audio");
+    }, Qt::QueuedConnection);
+    QMetaObject::invokeMethod(audioMixer, &AudioMixer::initialize, Qt::QueuedConnection);
     QMetaObject::invokeMethod(audioMixer, &AudioMixer::startMenuMusic, Qt::QueuedConnection);
 }
 
@@ -70,9 +79,6 @@ MainWindow::MainWindow(QWidget *parent)
 
     startAudioMixer();
 
-    // assembles .ROM file from segragated files.
-    std::unique_ptr<RomAssembler> r = std::make_unique<RomAssembler>();
-
     // Connect the buttons to their respective slots
     connect(ui->buttonPlay, &QPushButton::clicked, this, &MainWindow::onButtonPlayClicked);
     connect(ui->buttonSettings, &QPushButton::clicked, this, &MainWindow::onButtonSettingsClicked);
@@ -82,6 +88,9 @@ MainWindow::MainWindow(QWidget *parent)
     QShortcut* pauseShortcut = new QShortcut(QKeySequence("P"), this);
     QShortcut* resumeShortcut = new QShortcut(QKeySequence("R"), this);
     QShortcut* stepShortcut = new QShortcut(QKeySequence("S"), this);
+    QShortcut* traceShortcut = new QShortcut(QKeySequence("T"), this);
+    QShortcut* profileShortcut = new QShortcut(QKeySequence("F"), this);
+    QShortcut* hudShortcut = new QShortcut(QKeySequence("H"), this);
 
     // Connect the shortcuts to emulator actions
     connect(pauseShortcut, &QShortcut::activated, this, []() {
@@ -98,6 +107,25 @@ MainWindow::MainWindow(QWidget *parent)
         EmulatorWrapper::getInstance().stepEmulation();
         qDebug() << "Step shortcut activated!";
     });
+
+    connect(traceShortcut, &QShortcut::activated, this, []() {
+        EmulatorWrapper& emulator = EmulatorWrapper::getInstance();
+        emulator.setTracing(!emulator.isTracing());
+        qDebug() << "Trace shortcut activated!";
+    });
+
+    connect(profileShortcut, &QShortcut::activated, this, []() {
+        EmulatorWrapper& emulator = EmulatorWrapper::getInstance();
+        emulator.setProfiling(!emulator.isProfiling());
+        qDebug() << "Profile shortcut activated!";
+    });
+
+    connect(hudShortcut, &QShortcut::activated, this, [this]() {
+        if (pixelWidget) {
+            pixelWidget->setHudVisible(!pixelWidget->isHudVisible());
+        }
+        qDebug() << "HUD shortcut activated!";
+    });
 }
 
 
@@ -182,6 +210,7 @@ void MainWindow::loadKeyMappings()
             keyMappings["p2_button"] = keycodes[4] = jsonObject["p2_button"].toInt();
             keyMappings["insert_coin"] = keycodes[5] = jsonObject["insert_coin"].toInt();
             keyMappings["exit_game"] = keycodes[6] = jsonObject["exit_game"].toInt();
+            pauseWhenHidden = jsonObject["pause_when_hidden"].toBool(false);
         }
     } else {
         // If the file doesn't exist, use default from keymap.h
@@ -245,6 +274,7 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     // if the game is running and the inputManager thread is up
     if(inputManagerThread.isRunning() && isGameRunning)
     {
+        ChromeTrace::instant("key press");
         // process game related keys
         if(key == keycodes[0]) { inputManager->moveLeft(); }
         if(key == keycodes[1]) { inputManager->moveRight(); }
@@ -256,6 +286,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
         {
             // exit key pressed, exit game
             isGameRunning = false;
+            renderingSuspended = false;
+            pausedWhileHidden = false;
             outputManager->stopVideo();
 
             // terminate the input manager thread
@@ -299,6 +331,7 @@ void MainWindow::keyReleaseEvent(QKeyEvent *event)
     // if the game is running and the inputManager thread is up
     if(inputManagerThread.isRunning() && isGameRunning)
     {
+        ChromeTrace::instant("key release");
         // process game related keys
         if(key == keycodes[0]) { inputManager->moveLeftKeyup(); }
         if(key == keycodes[1]) { inputManager->moveRightKeyup(); }
@@ -351,6 +384,7 @@ void MainWindow::setMenuBackground()
  */
 void MainWindow::onButtonPlayClicked() {
     qDebug() << "\nPlay Game button clicked! Starting the game...";
+    StartupTimeline::mark("play pressed");
 
     // Set UI mode to "Game"
     setUIMode("Game");
@@ -386,6 +420,8 @@ void MainWindow::onButtonPlayClicked() {
         outputManagerThread.start();
         // Connect the frameReady signal to PixelWidget's renderFrame
         connect(outputManager, &OutputManager::frameReady, pixelWidget, &PixelWidget::updatePixelData);
+        // In beam racing mode frames arrive as bands of scanlines instead
+        connect(outputManager, &OutputManager::scanlinesReady, pixelWidget, &PixelWidget::updateScanlines);
         // Start the video thread
         outputManager->startVideo();
     }
@@ -467,6 +503,66 @@ void MainWindow::resizeEvent(QResizeEvent *event)
     }
 }
 
+/**
+ * @brief Suspends or resumes rendering when the window is minimized or restored.
+ */
+void MainWindow::changeEvent(QEvent *event)
+{
+    QMainWindow::changeEvent(event);
+    if (event->type() == QEvent::WindowStateChange) {
+        updateRenderSuspension();
+    }
+}
+
+void MainWindow::hideEvent(QHideEvent *event)
+{
+    QMainWindow::hideEvent(event);
+    updateRenderSuspension();
+}
+
+void MainWindow::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+    updateRenderSuspension();
+}
+
+/**
+ * @brief Stops frame conversion and repainting while nobody can see the game.
+ *
+ * The emulator keeps running unless "pause_when_hidden" is set in .settings.json.
+ * On resume the PixelWidget redraws the whole frame once.
+ */
+void MainWindow::updateRenderSuspension()
+{
+    if (!outputManager || !pixelWidget) {
+        return;
+    }
+
+    const bool hidden = isMinimized() || !isVisible();
+    if (hidden == renderingSuspended) {
+        return;
+    }
+    renderingSuspended = hidden;
+
+    EmulatorWrapper &emulator = EmulatorWrapper::getInstance();
+    if (hidden) {
+        outputManager->setVideoSuspended(true);
+        pixelWidget->setRenderingSuspended(true);
+        // Leave a debug pause alone so restoring the window does not resume it
+        if (pauseWhenHidden && !emulator.isPaused()) {
+            emulator.pauseEmulation();
+            pausedWhileHidden = true;
+        }
+    } else {
+        if (pausedWhileHidden) {
+            emulator.resumeEmulation();
+            pausedWhileHidden = false;
+        }
+        pixelWidget->setRenderingSuspended(false);
+        outputManager->setVideoSuspended(false);
+    }
+}
+
 void MainWindow::stopAudioMixer()
 {
     if (audioMixerThread->isRunning()) {
@@ -62,6 +62,9 @@ protected:
     void keyPressEvent(QKeyEvent *event) override;
     void keyReleaseEvent(QKeyEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void showEvent(QShowEvent *event) override;
 
 private slots:
     void onButtonPlayClicked();
@@ -80,6 +83,9 @@ private:
     PixelWidget *pixelWidget = nullptr;
 
     bool isGameRunning = false;
+    bool renderingSuspended = false; ///< Video is paused because the window is hidden or minimized
+    bool pauseWhenHidden = false;    ///< "pause_when_hidden" setting: also hold the emulator
+    bool pausedWhileHidden = false;  ///< The emulator was paused by us, not by the debug shortcut
 
     QMap<QString, int> keyMappings;
     QVector<int> keycodes;
@@ -94,6 +100,7 @@ private:
     void setUIMode(const QString &mode);
     void setGameBackground();
     void setMenuBackground();
+    void updateRenderSuspension();
 void startAudioMixer();
 };
 
@@ -0,0 +1,183 @@
+#include "performancehud.h"
+#include "../emulator/emulatorWrapper.h"
+#include "../outputmanager/audiomixer.h"
+#include <QFontMetrics>
+#include <QPainter>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr int MARGIN = 6;             ///< From the widget's corner
+constexpr int PADDING = 4;            ///< Inside the background box
+constexpr int TEXT_COLUMNS = 40;      ///< Box width in digits
+constexpr int GRAPH_HEIGHT = 40;
+constexpr float GRAPH_MS = 50.0f;     ///< Frame time at the top of the sparkline
+constexpr float TARGET_MS = 1000.0f / 60.0f;
+
+} // namespace
+
+PerformanceHud::PerformanceHud()
+    : visible(false),
+    font(QStringLiteral("monospace"))
+{
+    font.setStyleHint(QFont::Monospace);
+    font.setPixelSize(11);
+    const QFontMetrics metrics(font);
+    lineHeight = metrics.height();
+    width = metrics.horizontalAdvance(QLatin1Char('0')) * TEXT_COLUMNS + 2 * PADDING;
+    for (QStaticText& line : lines) {
+        line.setTextFormat(Qt::PlainText);
+        line.setPerformanceHint(QStaticText::AggressiveCaching);
+    }
+    clock.start();
+    reset();
+}
+
+void PerformanceHud::setVisible(bool show) {
+    if (show && !visible) {
+        reset(); // Rates and counts start afresh each time the overlay appears
+    }
+    visible = show;
+}
+
+void PerformanceHud::reset() {
+    primed = false;
+    lastPresentNs = 0;
+    lastEmulatedFrame = 0;
+    droppedFrames = 0;
+    duplicatedFrames = 0;
+    presentedFrames = 0;
+    std::fill(std::begin(frameTimes), std::end(frameTimes), 0.0f);
+    historyNext = 0;
+    historyCount = 0;
+
+    lastRefreshNs = clock.nsecsElapsed();
+    lastCycles = EmulatorWrapper::getInstance().getCycleCount();
+    for (int i = 0; i < ThreadCpu::MAX_THREADS; ++i) {
+        const bool known = i < ThreadCpu::count();
+        lastThreadGeneration[i] = known ? ThreadCpu::generation(i) : 0;
+        lastThreadCpu[i] = known ? ThreadCpu::cpuNs(i) : -1;
+    }
+    lineCount = 1;
+    lines[0].setText(QStringLiteral("Measuring..."));
+
+    drawLastMicroseconds = 0.0;
+    drawWorstMicroseconds = 0.0;
+    drawsOverBudget = 0;
+}
+
+void PerformanceHud::framePresented() {
+    const qint64 now = clock.nsecsElapsed();
+    const uint64_t frame = EmulatorWrapper::getInstance().getCycleCount() / EmulatorWrapper::CYCLES_PER_FRAME;
+
+    // Each presented frame should show the next emulated one
+    if (primed && frame >= lastEmulatedFrame) {
+        if (frame == lastEmulatedFrame) {
+            ++duplicatedFrames;
+        } else {
+            droppedFrames += frame - lastEmulatedFrame - 1;
+        }
+        frameTimes[historyNext] = float(now - lastPresentNs) / 1.0e6f;
+        historyNext = (historyNext + 1) % HISTORY_FRAMES;
+        historyCount = std::min(historyCount + 1, HISTORY_FRAMES);
+    }
+    primed = true;
+    lastPresentNs = now;
+    lastEmulatedFrame = frame;
+    ++presentedFrames;
+
+    if (now - lastRefreshNs >= REFRESH_MS * 1000000LL) {
+        refresh(now);
+    }
+}
+
+void PerformanceHud::refresh(qint64 now) {
+    const double seconds = (now - lastRefreshNs) / 1.0e9;
+    const uint64_t cycles = EmulatorWrapper::getInstance().getCycleCount();
+    const double emulated = cycles >= lastCycles ? double(cycles - lastCycles) : 0.0; // Restarted otherwise
+
+    lineCount = 0;
+    lines[lineCount++].setText(QString::asprintf("8080 %.3f MHz  emulated %.1f fps",
+                                                 emulated / seconds / 1.0e6,
+                                                 emulated / EmulatorWrapper::CYCLES_PER_FRAME / seconds));
+    lines[lineCount++].setText(QString::asprintf("presented %.1f fps  dropped %llu  dup %llu",
+                                                 presentedFrames / seconds,
+                                                 static_cast<unsigned long long>(droppedFrames),
+                                                 static_cast<unsigned long long>(duplicatedFrames)));
+
+    const FrameBudget::Summary budget = EmulatorWrapper::getInstance().getFrameBudget();
+    if (budget.frames > 0) {
+        lines[lineCount++].setText(QString::asprintf("game: ISR %.0f%%  main %.0f%%  idle %.0f%%",
+                                                     budget.isrPercent, budget.mainPercent, budget.idlePercent));
+    }
+    lines[lineCount++].setText(QString::asprintf("audio queued %.1f ms", AudioMixer::getInstance()->outputQueuedMs()));
+
+    for (int i = 0; i < ThreadCpu::count(); ++i) {
+        const uint32_t generation = ThreadCpu::generation(i);
+        const int64_t cpu = ThreadCpu::cpuNs(i);
+        if (cpu >= 0 && lastThreadCpu[i] >= 0 && generation == lastThreadGeneration[i]) {
+            lines[lineCount++].setText(QString::asprintf("CPU %-12s %5.1f%%", ThreadCpu::name(i),
+                                                         100.0 * (cpu - lastThreadCpu[i]) / (now - lastRefreshNs)));
+        }
+        lastThreadCpu[i] = cpu;
+        lastThreadGeneration[i] = generation;
+    }
+
+    lines[lineCount++].setText(QString::asprintf("overlay %.0f us (worst %.0f, %d over %.0f)",
+                                                 drawLastMicroseconds, drawWorstMicroseconds,
+                                                 drawsOverBudget, BUDGET_MICROSECONDS));
+    lines[lineCount++].setText(QString::asprintf("frame time, 0-%.0f ms", GRAPH_MS));
+
+    // Lay the text out now rather than in the first paint after the change
+    for (int i = 0; i < lineCount; ++i) {
+        lines[i].prepare(QTransform(), font);
+    }
+
+    lastRefreshNs = now;
+    lastCycles = cycles;
+    presentedFrames = 0;
+    drawWorstMicroseconds = 0.0;
+    drawsOverBudget = 0;
+}
+
+QRect PerformanceHud::area() const {
+    return QRect(MARGIN, MARGIN, width, lineCount * lineHeight + GRAPH_HEIGHT + 3 * PADDING);
+}
+
+void PerformanceHud::paint(QPainter& painter) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Drawn last, so the painter state is not saved: save() would allocate
+    const QRect box = area();
+    painter.fillRect(box, QColor(0, 0, 0, 170));
+    painter.setFont(font);
+    painter.setPen(QColor(120, 255, 120));
+    int y = box.top() + PADDING;
+    for (int i = 0; i < lineCount; ++i) {
+        painter.drawStaticText(box.left() + PADDING, y, lines[i]);
+        y += lineHeight;
+    }
+
+    // Sparkline, oldest frame on the left, with the 60 fps frame time marked
+    const QRectF graph(box.left() + PADDING, y + PADDING, box.width() - 2 * PADDING, GRAPH_HEIGHT);
+    const qreal targetY = graph.bottom() - graph.height() * TARGET_MS / GRAPH_MS;
+    painter.setPen(QColor(255, 255, 255, 90));
+    painter.drawLine(QPointF(graph.left(), targetY), QPointF(graph.right(), targetY));
+
+    const int oldest = (historyNext - historyCount + HISTORY_FRAMES) % HISTORY_FRAMES;
+    const qreal step = graph.width() / (HISTORY_FRAMES - 1);
+    for (int i = 0; i < historyCount; ++i) {
+        const float ms = std::min(frameTimes[(oldest + i) % HISTORY_FRAMES], GRAPH_MS);
+        sparkline[i] = QPointF(graph.left() + i * step, graph.bottom() - graph.height() * ms / GRAPH_MS);
+    }
+    painter.setPen(QColor(255, 220, 80));
+    painter.drawPolyline(sparkline, historyCount);
+
+    drawLastMicroseconds = timer.nsecsElapsed() / 1000.0;
+    drawWorstMicroseconds = std::max(drawWorstMicroseconds, drawLastMicroseconds);
+    if (drawLastMicroseconds > BUDGET_MICROSECONDS) {
+        ++drawsOverBudget;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef PERFORMANCEHUD_H
+#define PERFORMANCEHUD_H
+
+#include <QElapsedTimer>
+#include <QFont>
+#include <QPointF>
+#include <QRect>
+#include <QStaticText>
+#include <cstdint>
+#include "../diagnostics/threadcpu.h"
+
+class QPainter;
+
+/**
+ * @brief Live performance overlay drawn by PixelWidget over the game.
+ *
+ * Shows the effective 8080 clock, emulated and presented frame rates,
+ * dropped and duplicated frames, a sparkline of the time between presented
+ * frames, host CPU use per thread, the audio output queue and the game's
+ * frame budget. Everything is read from counters the emulator, mixer and
+ * threads already publish, so the other threads do no extra work.
+ *
+ * The text is rebuilt every REFRESH_MS; drawing a frame uses only fixed
+ * member storage and is timed against BUDGET_MICROSECONDS.
+ */
+class PerformanceHud {
+public:
+    static constexpr int HISTORY_FRAMES = 120;           ///< Frames in the sparkline
+    static constexpr int REFRESH_MS = 500;               ///< Interval between text updates
+    static constexpr double BUDGET_MICROSECONDS = 100.0; ///< Target cost of paint()
+
+    PerformanceHud();
+
+    void setVisible(bool show);
+    bool isVisible() const { return visible; }
+
+    /**
+     * @brief Records that a complete frame was presented. GUI thread only.
+     */
+    void framePresented();
+
+    /**
+     * @brief Widget area the overlay covers.
+     */
+    QRect area() const;
+
+    /**
+     * @brief Draws the overlay in its area. Call last; the painter's pen and font are changed.
+     */
+    void paint(QPainter& painter);
+
+private:
+    static constexpr int MAX_LINES = 8 + ThreadCpu::MAX_THREADS;
+
+    void reset();
+    void refresh(qint64 now);
+
+    bool visible;
+    QFont font;
+    int lineHeight;
+    int width;
+    QElapsedTimer clock;
+
+    // Presentation, updated every frame
+    bool primed;                  ///< A previous frame exists
+    qint64 lastPresentNs;
+    uint64_t lastEmulatedFrame;
+    uint64_t droppedFrames;       ///< Emulated frames that were never shown
+    uint64_t duplicatedFrames;    ///< Frames shown again because no new one was emulated
+    int presentedFrames;          ///< Since the last refresh
+    float frameTimes[HISTORY_FRAMES]; ///< Milliseconds between presented frames, a ring
+    int historyNext;
+    int historyCount;
+    QPointF sparkline[HISTORY_FRAMES];
+
+    // Sampled at each refresh
+    qint64 lastRefreshNs;
+    uint64_t lastCycles;
+    int64_t lastThreadCpu[ThreadCpu::MAX_THREADS];
+    uint32_t lastThreadGeneration[ThreadCpu::MAX_THREADS]; ///< A change means a different thread
+    QStaticText lines[MAX_LINES];
+    int lineCount;
+
+    // Cost of paint() since the last refresh
+    double drawLastMicroseconds;
+    double drawWorstMicroseconds;
+    int drawsOverBudget;
+};
+
+#endif // PERFORMANCEHUD_H
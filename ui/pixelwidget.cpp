@@ -1,7 +1,17 @@
 #include "pixelwidget.h"
 #include "../outputmanager/outputManager.h"
+#include "../diagnostics/startuptimeline.h"
+#include "../diagnostics/chrometrace.h"
 #include <QPainter>
+#include <QPaintEvent>
+#include <algorithm>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QColor>
 
 const int PixelWidget::frameSz = OutputManager::FRAME_SIZE;
 const int PixelWidget::frameHt = OutputManager::SCREEN_HEIGHT;
@@ -9,9 +19,16 @@ const int PixelWidget::frameWd = OutputManager::SCREEN_WIDTH;
 
 PixelWidget::PixelWidget(QWidget *parent)
     : QWidget(parent),
-    image(frameWd, frameHt, QImage::Format_Mono)
+    current(nullptr),
+    frame(frameWd, frameHt)
 {
-    image.fill(false);  // Initialize with black
+    loadSettings();
+
+    const int factor = scaler.factor();
+    image = QImage(frameWd * factor, frameHt * factor, QImage::Format_Indexed8);
+    const std::vector<uint32_t> &colours = palette.colourTable();
+    image.setColorTable(QVector<QRgb>(colours.begin(), colours.end()));
+    image.fill(VideoConverter::PIXEL_OFF);  // Initialize with black
     previous.resize(frameSz, 0);
 }
 
@@ -26,27 +43,200 @@ PixelWidget::~PixelWidget() {
     qDebug() << "PixelWidget destroyed.";
 }
 
+void PixelWidget::loadSettings()
+{
+    QFile settingsFile(QDir::currentPath() + "/.settings.json");
+    if (!settingsFile.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QJsonObject jsonObject = QJsonDocument::fromJson(settingsFile.readAll()).object();
+    const QString filterName = jsonObject["video_filter"].toString("none");
+    scaler.setFilter(PixelScaler::filterFromName(filterName.toStdString()));
+    qDebug() << "Video filter:" << PixelScaler::filterName(scaler.filter())
+             << "using" << PixelScaler::backendName() << "kernels";
+
+    palette.setBands(parseOverlay(jsonObject["overlay"]));
+
+    // "afterglow" is a bool or { "enabled": true, "half_life_ms": 25 }
+    QJsonValue glow = jsonObject["afterglow"];
+    afterglowEnabled = glow.isBool() ? glow.toBool() : glow.toObject()["enabled"].toBool(false);
+    if (afterglowEnabled) {
+        afterglow.setHalfLife(glow.toObject()["half_life_ms"].toDouble(25.0));
+        qDebug() << "Phosphor afterglow enabled.";
+    }
+
+    hud.setVisible(jsonObject["performance_hud"].toBool(false));
+}
+
+/*
+ * "overlay" may be a bool (true selects the classic cabinet gels) or an object:
+ *   { "enabled": true,
+ *     "bands": [ { "first_row": 32, "last_row": 63, "color": "#ff2020" }, ... ] }
+ * Rows are counted from the top of the upright screen; uncovered rows stay white.
+ */
+std::vector<VideoConverter::OverlayBand> PixelWidget::parseOverlay(const QJsonValue &overlay)
+{
+    std::vector<VideoConverter::OverlayBand> bands;
+    if (overlay.isBool()) {
+        if (overlay.toBool()) {
+            bands = VideoConverter::RowPalette::classicBands();
+        }
+        return bands;
+    }
+
+    QJsonObject overlayObject = overlay.toObject();
+    if (!overlayObject["enabled"].toBool(false)) {
+        return bands;
+    }
+    if (!overlayObject.contains("bands")) {
+        return VideoConverter::RowPalette::classicBands();
+    }
 
+    for (const QJsonValue &bandValue : overlayObject["bands"].toArray()) {
+        QJsonObject bandObject = bandValue.toObject();
+        QColor colour(bandObject["color"].toString());
+        if (!colour.isValid()) {
+            qWarning() << "Ignoring overlay band with invalid color:" << bandObject["color"].toString();
+            continue;
+        }
+        bands.push_back({
+            bandObject["first_row"].toInt(0),
+            bandObject["last_row"].toInt(frameHt - 1),
+            static_cast<uint32_t>(colour.rgb() & 0xffffff)
+        });
+    }
+    if (bands.size() > VideoConverter::MAX_BANDS - 1) {
+        qWarning() << "Only the first" << VideoConverter::MAX_BANDS - 1 << "overlay bands are used.";
+    }
+    return bands;
+}
 
 void PixelWidget::updatePixelData() {
+    CHROME_TRACE_SCOPE("render frame");
+    if (renderingSuspended) {
+        return;
+    }
     current = OutputManager::getInstance()->getFrame();
-    for (int y = 0; y < frameHt; ++y) {
-        for (int x = 0; x < frameWd; ++x) {
-            int pixelState = getPixel(x, y);
-            image.setPixel(x, y, pixelState);
-        }
+    if (!current) {
+        return;
     }
+
+    renderColumns(0, frameWd);
+    if (afterglowEnabled) {
+        trackAfterglowBudget(afterglow.lastMicroseconds());
+    }
+    presentHud();
     update(); // Trigger UI refresh
 }
 
+void PixelWidget::updateScanlines(int firstScanline, int lastScanline) {
+    CHROME_TRACE_SCOPE("render band");
+    if (renderingSuspended) {
+        return;
+    }
+    current = OutputManager::getInstance()->getFrame();
+    if (!current) {
+        return;
+    }
+
+    renderColumns(firstScanline, lastScanline);
+    if (afterglowEnabled) {
+        afterglowFrameCost += afterglow.lastMicroseconds();
+        if (lastScanline >= frameWd) {
+            trackAfterglowBudget(afterglowFrameCost);
+            afterglowFrameCost = 0.0;
+        }
+    }
+
+    // Present just this band; pad by a pixel for the smoothing filter at the edges
+    const int left = firstScanline * width() / frameWd;
+    const int right = (lastScanline * width() + frameWd - 1) / frameWd;
+    update(QRect(left - 1, 0, right - left + 2, height()));
+    if (lastScanline >= frameWd) {
+        presentHud();
+    }
+}
+
+void PixelWidget::setRenderingSuspended(bool suspended) {
+    if (renderingSuspended == suspended) {
+        return;
+    }
+    renderingSuspended = suspended;
+    if (suspended) {
+        return;
+    }
+
+    // The glow history is stale after a pause, and any half-presented beam
+    // frame is incomplete, so start over with one full refresh.
+    afterglow.reset();
+    afterglowFrameCost = 0.0;
+    updatePixelData();
+}
+
+void PixelWidget::setHudVisible(bool visible) {
+    update(hud.area()); // Covers the old overlay when hiding it
+    hud.setVisible(visible);
+    update(hud.area());
+}
+
+void PixelWidget::presentHud() {
+    if (hud.isVisible()) {
+        hud.framePresented();
+        update(hud.area());
+    }
+}
+
+void PixelWidget::renderColumns(int firstColumn, int lastColumn) {
+    VideoConverter::convertColumns(current, palette, frame, firstColumn, lastColumn);
+    if (afterglowEnabled) {
+        afterglow.apply(frame, palette, firstColumn, lastColumn);
+    }
+
+    // The filters look up to two pixels to either side, so rescale the edge
+    // of the previous band now that its right-hand neighbours are current.
+    scaler.scale(frame, image.bits(), image.bytesPerLine(), std::max(firstColumn - 2, 0), lastColumn);
+
+    if (!firstFrameRendered) {
+        firstFrameRendered = true;
+        StartupTimeline::mark("first game frame");
+    }
+}
+
+void PixelWidget::trackAfterglowBudget(double cost)
+{
+    afterglowWorst = std::max(afterglowWorst, cost);
+    if (cost > Afterglow::BUDGET_MICROSECONDS) {
+        ++afterglowOverBudget;
+    }
+
+    // Report roughly every ten seconds at 60 fps
+    if (++afterglowFrames >= 600) {
+        if (afterglowOverBudget > 0) {
+            qWarning("Afterglow exceeded its %.0f us budget on %d of %d frames (worst %.1f us)",
+                     Afterglow::BUDGET_MICROSECONDS, afterglowOverBudget, afterglowFrames, afterglowWorst);
+        } else {
+            qDebug("Afterglow within budget, worst frame %.1f us", afterglowWorst);
+        }
+        afterglowFrames = 0;
+        afterglowOverBudget = 0;
+        afterglowWorst = 0.0;
+    }
+}
+
 void PixelWidget::paintEvent(QPaintEvent *event) {
+    CHROME_TRACE_SCOPE("paint");
     QPainter painter(this);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
-    painter.drawImage(rect(), image);
-}
 
-int PixelWidget::getPixel(int x, int y) const {
-    int byteIndex = ((x + 1) * frameHt / 8) - y / 8;
-    int bitIndex = 7 - (y % 8);
-    return (current[byteIndex] >> bitIndex) & 1;
+    // Only convert and draw the part of the image that was invalidated
+    const QRectF target = event->rect();
+    const qreal sx = qreal(image.width()) / width();
+    const qreal sy = qreal(image.height()) / height();
+    const QRectF source(target.x() * sx, target.y() * sy, target.width() * sx, target.height() * sy);
+    painter.drawImage(target, image, source);
+
+    if (hud.isVisible() && event->rect().intersects(hud.area())) {
+        hud.paint(painter);
+    }
 }
@@ -3,12 +3,23 @@
 
 #include <QWidget>
 #include <QImage>
+#include <QJsonValue>
+#include "../outputmanager/videoconverter.h"
+#include "../outputmanager/pixelscaler.h"
+#include "../outputmanager/afterglow.h"
+#include "performancehud.h"
 
 /**
  * @brief PixelWidget is responsible for rendering the video frames.
  *
  * This widget renders a frame of pixels based on the binary data
- * retrieved from the emulator's video memory.
+ * retrieved from the emulator's video memory. The frame is converted
+ * to 8-bit palette indices and run through the upscaling filter selected
+ * by the "video_filter" key in .settings.json. The optional colour
+ * overlay ("overlay" key) is applied by the conversion palette, and the
+ * optional phosphor afterglow ("afterglow" key) runs between conversion
+ * and scaling. The performance overlay ("performance_hud" key) is drawn
+ * on top.
  */
 class PixelWidget : public QWidget {
     Q_OBJECT
@@ -22,20 +33,78 @@ public:
      */
     void renderFrame();
 
+    bool isHudVisible() const { return hud.isVisible(); }
+
 public slots:
     /**
      * @brief Updates the pixel data in the QImage based on emulator memory.
      */
     void updatePixelData();
 
+    /**
+     * @brief Beam racing: converts and presents scanlines [firstScanline, lastScanline).
+     *
+     * Scanlines are video RAM rows, which are the displayed columns of the upright screen.
+     */
+    void updateScanlines(int firstScanline, int lastScanline);
+
+    /**
+     * @brief Drops incoming frames while the window cannot be seen.
+     *
+     * Resuming clears the afterglow history and redraws the whole frame once.
+     */
+    void setRenderingSuspended(bool suspended);
+
+    /**
+     * @brief Shows or hides the performance overlay.
+     */
+    void setHudVisible(bool visible);
+
 protected:
     void paintEvent(QPaintEvent *event) override;
 
 private:
-    QImage image; ///< The QImage used for rendering.
+    QImage image; ///< The scaled QImage used for rendering.
     const uint8_t* current;
     std::vector<uint8_t> previous; ///< Buffer to store the previous frame.
-    int getPixel(int x, int y) const;
+
+    VideoFrame frame;   ///< Video RAM converted to one palette index per pixel.
+    PixelScaler scaler; ///< Upscaling filter applied to the converted frame.
+    VideoConverter::RowPalette palette; ///< Per-row colours for the overlay gels.
+    Afterglow afterglow;                ///< Phosphor persistence applied after conversion.
+    bool renderingSuspended = false;    ///< Frames are ignored while the window is hidden.
+    bool firstFrameRendered = false;    ///< For the startup timeline.
+    bool afterglowEnabled = false;
+    int afterglowFrames = 0;            ///< Frames since the last afterglow timing report.
+    int afterglowOverBudget = 0;        ///< Frames in that window that exceeded the budget.
+    double afterglowWorst = 0.0;        ///< Slowest frame in that window, in microseconds.
+    double afterglowFrameCost = 0.0;    ///< Accumulated cost of the bands of the current frame.
+    PerformanceHud hud;                 ///< Drawn over the frame when visible.
+
+    /**
+     * @brief Feeds a completed frame to the overlay and schedules its redraw.
+     */
+    void presentHud();
+
+    /**
+     * @brief Records the afterglow cost of one frame and periodically reports it.
+     */
+    void trackAfterglowBudget(double cost);
+
+    /**
+     * @brief Converts, post-processes and scales source columns [firstColumn, lastColumn).
+     */
+    void renderColumns(int firstColumn, int lastColumn);
+
+    /**
+     * @brief Reads the video settings from .settings.json.
+     */
+    void loadSettings();
+
+    /**
+     * @brief Parses the "overlay" settings object into colour bands.
+     */
+    static std::vector<VideoConverter::OverlayBand> parseOverlay(const QJsonValue &overlay);
 
     static const int frameSz;
     static const int frameHt;
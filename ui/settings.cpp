@@ -234,8 +234,8 @@ void Settings::onOkButtonClicked()
     QString keymapPath = QDir::currentPath() + "/.settings.json";
     QFile keymapFile(keymapPath);
 
-    // Create a JSON object to store the updated key mappings
-    QJsonObject updatedKeymapJson;
+    // Start from the loaded settings so keys this dialog does not edit (video, audio) survive
+    QJsonObject updatedKeymapJson = currentKeymap;
 
     // Read the values from the lineEdit fields and convert them to key sequences
     QKeySequence fireKeySeq(ui->lineEditFire->text());